@@ -0,0 +1,169 @@
+// Benchmark.cpp
+
+#include "Benchmark.h"
+
+#include "Engine.h"
+#include "Grid.h"
+#include "Heatmap.h"
+#include "PerfCounters.h"
+#include "PixelExpand.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Every path starts from the same field
+static const uint32_t BenchmarkSeed = 23;
+
+// Time ExpandGrid at a few scales and check every pixel against the reference
+// lookup. Returns the number of scales whose output didn't match.
+static int BenchmarkExpand( Grid& grid ) {
+	const int width = grid.GetWidth( );
+	const int height = grid.GetHeight( );
+	std::vector<Cell> cells( (size_t)width * height );
+	for ( int y = 0; y < height; y++ )
+		std::copy( grid.Row( y ), grid.Row( y ) + width, cells.begin( ) + (size_t)y * width );
+	Palette palette;
+	palette.Colors[0] = PackColor( 0, 0, 0, 255 );
+	palette.Colors[1] = PackColor( 255, 255, 255, 255 );
+
+	int failures = 0;
+	for ( int scale : { 1, 2, 4 } ) {
+		const size_t outWidth = (size_t)width * scale;
+		std::vector<uint32_t> pixels( outWidth * height * scale );
+		auto start = std::chrono::steady_clock::now( );
+		ExpandGrid( cells.data( ), width, height, scale, palette, pixels.data( ) );
+		double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+
+		std::vector<uint32_t> row( width );
+		bool match = true;
+		for ( size_t y = 0; y < (size_t)height * scale && match; y++ ) {
+			ExpandCellsReference( cells.data( ) + y / scale * width, width, palette, row.data( ) );
+			for ( size_t x = 0; x < outWidth && match; x++ )
+				match = pixels[y * outWidth + x] == row[x / scale];
+		}
+		failures += !match;
+		printf( "ExpandGrid x%-18d %9.3f ms       %9.1f Mpixels/s  %s\n", scale, seconds * 1000.0,
+			pixels.size( ) / seconds / 1e6, match ? "matches reference" : "MISMATCH" );
+	}
+	return failures;
+}
+
+// Time AccumulateHeat over a generation of the grid at a few decay rates and
+// check it against the plain loop. Returns the number of rates that didn't match.
+static int BenchmarkHeat( Grid& grid ) {
+	const int width = grid.GetWidth( );
+	const int height = grid.GetHeight( );
+	const size_t count = (size_t)width * height;
+	std::vector<Cell> before( count );
+	std::vector<Cell> after( count );
+	for ( int y = 0; y < height; y++ )
+		std::copy( grid.Row( y ), grid.Row( y ) + width, before.begin( ) + (size_t)y * width );
+	grid.Tick( );
+	for ( int y = 0; y < height; y++ )
+		std::copy( grid.Row( y ), grid.Row( y ) + width, after.begin( ) + (size_t)y * width );
+
+	int failures = 0;
+	for ( int decayShift : { 1, 3, 6 } ) {
+		// Every heat value, so saturation and decay to zero are both covered
+		std::vector<uint8_t> heat( count );
+		for ( size_t i = 0; i < count; i++ )
+			heat[i] = (uint8_t)( i * 7 );
+		std::vector<uint8_t> expected = heat;
+		auto start = std::chrono::steady_clock::now( );
+		for ( int y = 0; y < height; y++ ) {
+			const size_t row = (size_t)y * width;
+			AccumulateHeat( heat.data( ) + row, before.data( ) + row, after.data( ) + row, width, decayShift );
+		}
+		double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+		for ( int y = 0; y < height; y++ ) {
+			const size_t row = (size_t)y * width;
+			AccumulateHeatReference( expected.data( ) + row, before.data( ) + row, after.data( ) + row, width, decayShift );
+		}
+		const bool match = heat == expected;
+		failures += !match;
+		printf( "AccumulateHeat decay 1/%-7d %9.3f ms       %9.1f Mcells/s  %s\n", 1 << decayShift, seconds * 1000.0,
+			count / seconds / 1e6, match ? "matches reference" : "MISMATCH" );
+	}
+	return failures;
+}
+
+// Time every registered engine on the benchmark field and check its hash
+// against the grid's own tick. Returns the number of engines that disagreed.
+static int BenchmarkEngines( int width, int height, int ticks ) {
+	Grid reference( width, height );
+	reference.Randomize( 0.5f, BenchmarkSeed );
+	for ( int i = 0; i < ticks; i++ )
+		reference.TickWithMultithreading( );
+	std::unique_ptr<Engine> hasher = CreateEngine( DefaultEngineName );
+	hasher->Attach( reference );
+	const uint64_t expected = hasher->Hash( );
+
+	int failures = 0;
+	const uint64_t cells = (uint64_t)width * height;
+	for ( const EngineInfo& info : RegisteredEngines( ) ) {
+		Grid grid( width, height );
+		grid.Randomize( 0.5f, BenchmarkSeed );
+		std::unique_ptr<Engine> engine = info.Create( );
+		engine->Attach( grid );
+		auto start = std::chrono::steady_clock::now( );
+		engine->Step( ticks, true );
+		double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+		const bool match = engine->Hash( ) == expected;
+		failures += !match;
+		printf( "Engine %-23s %9.3f ms/tick %9.1f Mcells/s  %s\n", info.Name,
+			seconds * 1000.0 / ticks, cells * ticks / seconds / 1e6, match ? "matches reference" : "MISMATCH" );
+		engine->Detach( );
+	}
+	return failures;
+}
+
+int RunBenchmark( int width, int height, int ticks ) {
+	struct Path {
+		const char* name;
+		void ( Grid::*tick )( );
+		bool ages;
+		bool heat;
+	};
+	const Path paths[] = {
+		{ "Tick", &Grid::Tick, false, false },
+		{ "TickWithMultithreading", &Grid::TickWithMultithreading, false, false },
+		{ "Tick + ages", &Grid::Tick, true, false },
+		{ "TickWithMultithreading + ages", &Grid::TickWithMultithreading, true, false },
+		{ "Tick + heat", &Grid::Tick, false, true },
+		{ "TickWithMultithreading + heat", &Grid::TickWithMultithreading, false, true },
+	};
+
+	PerfCounters counters;
+	if ( !counters.Open( ) )
+		printf( "Hardware counters unavailable: %s\n", counters.GetError( ).c_str( ) );
+	else if ( !counters.GetError( ).empty( ) )
+		printf( "Some hardware counters unavailable: %s\n", counters.GetError( ).c_str( ) );
+
+	printf( "Grid %dx%d, %d ticks per path\n", width, height, ticks );
+	const uint64_t cells = (uint64_t)width * height;
+	for ( const Path& path : paths ) {
+		// Same starting field for every path
+		Grid grid( width, height );
+		grid.Randomize( 0.5f, BenchmarkSeed );
+		grid.TrackAges( path.ages );
+		grid.TrackHeat( path.heat );
+		counters.Start( );
+		auto start = std::chrono::steady_clock::now( );
+		for ( int i = 0; i < ticks; i++ )
+			( grid.*path.tick )( );
+		double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+		PerfSample sample = counters.Stop( cells * ticks );
+		printf( "%-30s %9.3f ms/tick %9.1f Mcells/s  %s\n", path.name,
+			seconds * 1000.0 / ticks, cells * ticks / seconds / 1e6,
+			counters.IsAvailable( ) ? sample.Summary( ).c_str( ) : "" );
+	}
+
+	Grid grid( width, height );
+	grid.Randomize( 0.5f, BenchmarkSeed );
+	int failures = BenchmarkEngines( width, height, ticks );
+	failures += BenchmarkExpand( grid );
+	failures += BenchmarkHeat( grid );
+	return failures ? 1 : 0;
+}
\ No newline at end of file
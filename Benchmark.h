@@ -0,0 +1,9 @@
+// Benchmark.h
+
+#pragma once
+
+// Time every tick path on a randomized grid without opening a window and
+// print the results, with hardware counters where the platform allows.
+// Also times every registered engine, pixel expansion and heat accumulation;
+// returns nonzero if any disagrees with the reference.
+int RunBenchmark( int width, int height, int ticks );
\ No newline at end of file
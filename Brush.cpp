@@ -0,0 +1,127 @@
+// Brush.cpp
+
+#include "Brush.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+// Slack for boundary cells lost to float rounding in the capsule test
+static const float Epsilon = 1e-4f;
+
+// Narrow [xmin, xmax] to the x where lo <= a * x + b <= hi
+static void ClipLinear( float a, float b, float lo, float hi, float& xmin, float& xmax ) {
+	if ( a == 0 ) {
+		if ( b < lo || b > hi ) {
+			xmin = 1;
+			xmax = 0;
+		}
+		return;
+	}
+	float x0 = ( lo - b ) / a;
+	float x1 = ( hi - b ) / a;
+	if ( x0 > x1 )
+		std::swap( x0, x1 );
+	xmin = std::max( xmin, x0 );
+	xmax = std::min( xmax, x1 );
+}
+
+// Union of the squares stamped at every Bresenham step of the corner's path.
+// The corner's y only ever moves one way, so the squares covering a row are
+// those stamped on the extent + 1 line rows above it, and their x range is set
+// by the first and last of those line rows.
+static void SweepSquare( int x0, int y0, int x1, int y1, int extent, std::vector<Span>& spans ) {
+	const int rows = abs( y1 - y0 ) + 1;
+	const int sy = y0 < y1 ? 1 : -1;
+	std::vector<int> rowMin( rows, INT_MAX );
+	std::vector<int> rowMax( rows, INT_MIN );
+	int dx = abs( x1 - x0 );
+	int sx = x0 < x1 ? 1 : -1;
+	int dy = -abs( y1 - y0 );
+	int error = dx + dy;
+	int x = x0;
+	int y = y0;
+	while ( true ) {
+		int row = ( y - y0 ) * sy;
+		rowMin[row] = std::min( rowMin[row], x );
+		rowMax[row] = std::max( rowMax[row], x );
+		if ( x == x1 && y == y1 ) break;
+		int e2 = 2 * error;
+		if ( e2 >= dy ) {
+			error += dy;
+			x += sx;
+		}
+		if ( e2 <= dx ) {
+			error += dx;
+			y += sy;
+		}
+	}
+	const int top = std::min( y0, y1 );
+	for ( int cy = top; cy <= top + rows - 1 + extent; cy++ ) {
+		// Line rows, counted from top, whose squares reach row cy
+		int first = std::max( cy - extent, top ) - top;
+		int last = std::min( cy, top + rows - 1 ) - top;
+		if ( sy < 0 ) {
+			first = rows - 1 - first;
+			last = rows - 1 - last;
+		}
+		spans.push_back( { cy, std::min( rowMin[first], rowMin[last] ), std::max( rowMax[first], rowMax[last] ) + extent } );
+	}
+}
+
+// Cells within size / 2 of the segment between the disc centers
+static void SweepDisc( int x0, int y0, int x1, int y1, int size, std::vector<Span>& spans ) {
+	const float cx0 = (float)( x0 + size / 2 );
+	const float cy0 = (float)( y0 + size / 2 );
+	const float cx1 = (float)( x1 + size / 2 );
+	const float cy1 = (float)( y1 + size / 2 );
+	const float radiusSq = size * size * 0.25f + Epsilon;
+	const float radius = std::sqrt( radiusSq );
+	const float dx = cx1 - cx0;
+	const float dy = cy1 - cy0;
+	const float lengthSq = dx * dx + dy * dy;
+	const int top = (int)std::floor( std::min( cy0, cy1 ) - radius );
+	const int bottom = (int)std::ceil( std::max( cy0, cy1 ) + radius );
+	for ( int y = top; y <= bottom; y++ ) {
+		float left = INFINITY;
+		float right = -INFINITY;
+		// The end caps
+		const float centers[2][2] = { { cx0, cy0 }, { cx1, cy1 } };
+		for ( const auto& center : centers ) {
+			float offset = y - center[1];
+			if ( offset * offset > radiusSq )
+				continue;
+			float half = std::sqrt( radiusSq - offset * offset );
+			left = std::min( left, center[0] - half );
+			right = std::max( right, center[0] + half );
+		}
+		// The band between them: projection onto the segment within its length
+		// and distance from its line within the radius
+		if ( lengthSq > 0 ) {
+			float xmin = -INFINITY;
+			float xmax = INFINITY;
+			float ry = y - cy0;
+			ClipLinear( dx, dy * ry - dx * cx0, 0, lengthSq, xmin, xmax );
+			const float reach = radius * std::sqrt( lengthSq );
+			ClipLinear( -dy, dx * ry + dy * cx0, -reach, reach, xmin, xmax );
+			if ( xmin <= xmax ) {
+				left = std::min( left, xmin );
+				right = std::max( right, xmax );
+			}
+		}
+		if ( left > right )
+			continue;
+		int start = (int)std::ceil( left - Epsilon );
+		int end = (int)std::floor( right + Epsilon );
+		if ( start <= end )
+			spans.push_back( { y, start, end } );
+	}
+}
+
+void RasterizeStroke( int x0, int y0, int x1, int y1, int size, bool round, std::vector<Span>& spans ) {
+	if ( round && size > 1 )
+		SweepDisc( x0, y0, x1, y1, size, spans );
+	else
+		SweepSquare( x0, y0, x1, y1, size > 1 ? size : 0, spans );
+}
\ No newline at end of file
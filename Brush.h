@@ -0,0 +1,21 @@
+// Brush.h
+
+#pragma once
+
+#include <vector>
+
+// Cells X0..X1 (inclusive) of row Y. Coordinates may lie outside the grid;
+// Grid::FillSpan wraps or clips them.
+struct Span {
+	int Y;
+	int X0;
+	int X1;
+};
+
+// Rasterize the shape a brush sweeps moving from (x0, y0) to (x1, y1) as one
+// span per row. The brush covers the same cells as a stamp at (x, y) always
+// has: a (size + 1) square with (x, y) as its top-left corner, or the disc of
+// diameter size inside it when round (a single cell for sizes up to 1). Swept,
+// the square becomes a hexagon and the disc a capsule, so every cell is
+// written once per stroke however long or wide it is.
+void RasterizeStroke( int x0, int y0, int x1, int y1, int size, bool round, std::vector<Span>& spans );
\ No newline at end of file
@@ -0,0 +1,111 @@
+// DensityPyramid.cpp
+
+#include "DensityPyramid.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+#include "Simulation.h"
+
+void DensityPyramid::Update( const GridSnapshot& snapshot, int count ) {
+	PROFILE_ZONE( "DensityPyramid::Update" );
+	// A new size invalidates everything already counted
+	if ( snapshot.Width != width || snapshot.Height != height ) {
+		width = snapshot.Width;
+		height = snapshot.Height;
+		levels.clear( );
+	}
+	// Levels are kept once built, so zooming back in and out costs nothing;
+	// new ones are counted in full from the level below
+	const int built = (int)levels.size( );
+	for ( int k = built + 1; k <= count; k++ ) {
+		Level level;
+		level.Width = ( width + ( 1 << k ) - 1 ) >> k;
+		level.Height = ( height + ( 1 << k ) - 1 ) >> k;
+		level.Counts.assign( (size_t)level.Width * level.Height, 0 );
+		level.RowStamps.assign( level.Height, 0 );
+		levels.push_back( std::move( level ) );
+	}
+
+	for ( int k = 1; k <= (int)levels.size( ); k++ ) {
+		Level& level = levels[k - 1];
+		const bool full = k > built;
+		for ( int y = 0; y < level.Height; y++ ) {
+			// Rows of the level below (or cell rows) this block row is built from
+			int below0 = y * 2;
+			int below1 = std::min( below0 + 1, k == 1 ? height - 1 : levels[k - 2].Height - 1 );
+			uint64_t rowStamp = k == 1
+				? std::max( snapshot.RowStamps[below0], snapshot.RowStamps[below1] )
+				: std::max( levels[k - 2].RowStamps[below0], levels[k - 2].RowStamps[below1] );
+			if ( !full && rowStamp <= stamp )
+				continue;
+			CountRow( snapshot, k, y );
+			level.RowStamps[y] = rowStamp;
+		}
+	}
+	stamp = snapshot.Stamp;
+}
+
+void DensityPyramid::CountRow( const GridSnapshot& snapshot, int k, int y ) {
+	Level& level = levels[k - 1];
+	uint32_t* out = level.Counts.data( ) + (size_t)y * level.Width;
+	if ( k == 1 ) {
+		const Cell* top = snapshot.Cells.data( ) + (size_t)( y * 2 ) * width;
+		const Cell* bottom = y * 2 + 1 < height ? top + width : nullptr;
+		for ( int x = 0; x < level.Width; x++ ) {
+			int x0 = x * 2;
+			int x1 = x0 + 1;
+			uint32_t sum = top[x0];
+			if ( x1 < width )
+				sum += top[x1];
+			if ( bottom ) {
+				sum += bottom[x0];
+				if ( x1 < width )
+					sum += bottom[x1];
+			}
+			out[x] = sum;
+		}
+		return;
+	}
+	const Level& below = levels[k - 2];
+	const uint32_t* top = below.Counts.data( ) + (size_t)( y * 2 ) * below.Width;
+	const uint32_t* bottom = y * 2 + 1 < below.Height ? top + below.Width : nullptr;
+	for ( int x = 0; x < level.Width; x++ ) {
+		int x0 = x * 2;
+		int x1 = x0 + 1;
+		uint32_t sum = top[x0];
+		if ( x1 < below.Width )
+			sum += top[x1];
+		if ( bottom ) {
+			sum += bottom[x0];
+			if ( x1 < below.Width )
+				sum += bottom[x1];
+		}
+		out[x] = sum;
+	}
+}
+
+int DensityPyramid::GetLevels( ) {
+	return (int)levels.size( );
+}
+
+int DensityPyramid::LevelWidth( int level ) {
+	return levels[level - 1].Width;
+}
+
+int DensityPyramid::LevelHeight( int level ) {
+	return levels[level - 1].Height;
+}
+
+uint64_t DensityPyramid::RowStamp( int level, int y ) {
+	return levels[level - 1].RowStamps[y];
+}
+
+void DensityPyramid::Densities( int k, int y, uint8_t* out ) {
+	const Level& level = levels[k - 1];
+	const uint32_t* counts = level.Counts.data( ) + (size_t)y * level.Width;
+	// A full block holds 4^k cells
+	const int shift = 2 * k;
+	for ( int x = 0; x < level.Width; x++ )
+		out[x] = (uint8_t)( ( (uint64_t)counts[x] * 255 ) >> shift );
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+// DensityPyramid.h
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct GridSnapshot;
+
+// Live-cell counts per 2^k x 2^k block of a snapshot, for drawing zoomed out.
+// Level k (k >= 1) is ceil(Width / 2^k) x ceil(Height / 2^k) counts, each built
+// from four counts of the level below. Every level row carries the newest row
+// stamp it was built from, so an update only recounts blocks over rows that
+// changed and the renderer can upload just those.
+class DensityPyramid {
+public:
+	// Build levels 1..count if missing and bring every built level up to date
+	void Update( const GridSnapshot& snapshot, int count );
+
+	int GetLevels( );
+	int LevelWidth( int level );
+	int LevelHeight( int level );
+	uint64_t RowStamp( int level, int y );
+
+	// Row y of a level as densities from 0 (empty block) to 255 (full block)
+	void Densities( int level, int y, uint8_t* out );
+
+private:
+	struct Level {
+		int Width = 0;
+		int Height = 0;
+		std::vector<uint32_t> Counts;
+		std::vector<uint64_t> RowStamps;
+	};
+
+	// Recount one row of a level from the level below (or the cells for level 1)
+	void CountRow( const GridSnapshot& snapshot, int level, int y );
+
+	std::vector<Level> levels;			// levels[0] is level 1
+	int width = 0;
+	int height = 0;
+	uint64_t stamp = 0;					// Snapshot stamp the levels are current up to
+};
\ No newline at end of file
@@ -0,0 +1,218 @@
+// EditQueue.cpp
+
+#include "EditQueue.h"
+
+#include <algorithm>
+#include <utility>
+
+EditOp EditOp::FillSpan( const Span& span, Cell value ) {
+	EditOp edit( EditFillSpan );
+	edit.Row = span;
+	edit.Value = value;
+	return edit;
+}
+
+EditOp EditOp::FillRect( int x, int y, int width, int height, Cell value ) {
+	EditOp edit( EditFillRect );
+	edit.Rect = { x, y, width, height };
+	edit.Value = value;
+	return edit;
+}
+
+EditOp EditOp::FloodFill( int x, int y, Cell value ) {
+	EditOp edit( EditFloodFill );
+	edit.Point = { x, y };
+	edit.Value = value;
+	return edit;
+}
+
+EditOp EditOp::Paste( int x, int y, Pattern pattern ) {
+	EditOp edit( EditPaste );
+	edit.Block = { x, y, new Pattern( std::move( pattern ) ) };
+	return edit;
+}
+
+EditOp EditOp::Rotate( int x, int y, int width, int height ) {
+	EditOp edit( EditRotate );
+	edit.Rect = { x, y, width, height };
+	return edit;
+}
+
+EditOp EditOp::FlipHorizontal( int x, int y, int width, int height ) {
+	EditOp edit( EditFlipHorizontal );
+	edit.Rect = { x, y, width, height };
+	return edit;
+}
+
+EditOp EditOp::FlipVertical( int x, int y, int width, int height ) {
+	EditOp edit( EditFlipVertical );
+	edit.Rect = { x, y, width, height };
+	return edit;
+}
+
+EditOp EditOp::Clear( ) {
+	return EditOp( EditClear );
+}
+
+EditOp EditOp::Randomize( float percent, int iterations ) {
+	EditOp edit( EditRandomize );
+	edit.Random = { percent, iterations, false, 0 };
+	return edit;
+}
+
+EditOp EditOp::Randomize( float percent, int iterations, uint32_t seed ) {
+	EditOp edit( EditRandomize );
+	edit.Random = { percent, iterations, true, seed };
+	return edit;
+}
+
+EditOp EditOp::SetRules( const Rules& rules ) {
+	EditOp edit( EditSetRules );
+	edit.NewRules = rules;
+	return edit;
+}
+
+EditOp EditOp::Resize( int width, int height ) {
+	EditOp edit( EditResize );
+	edit.Size = { width, height };
+	return edit;
+}
+
+EditOp EditOp::Load( int width, int height, std::vector<Cell> cells, uint64_t generation, uint32_t seed ) {
+	EditOp edit( EditLoad );
+	edit.World = { width, height, new std::vector<Cell>( std::move( cells ) ), generation, seed };
+	return edit;
+}
+
+EditOp EditOp::Step( ) {
+	return EditOp( EditStep );
+}
+
+EditOp EditOp::Seek( uint64_t generation ) {
+	EditOp edit( EditSeek );
+	edit.Rewind.Generation = generation;
+	return edit;
+}
+
+EditOp EditOp::Checkpoint( ) {
+	return EditOp( EditCheckpoint );
+}
+
+EditOp EditOp::Undo( ) {
+	return EditOp( EditUndo );
+}
+
+EditOp EditOp::Redo( ) {
+	return EditOp( EditRedo );
+}
+
+EditOp EditOp::ResetCounters( ) {
+	return EditOp( EditResetCounters );
+}
+
+EditQueue::~EditQueue( ) {
+	Batch* batch = head.exchange( nullptr );
+	while ( batch ) {
+		for ( EditOp& edit : batch->Edits ) {
+			if ( edit.Type == EditPaste )
+				delete edit.Block.Cells;
+			else if ( edit.Type == EditLoad )
+				delete edit.World.Cells;
+		}
+		Batch* next = batch->Next;
+		delete batch;
+		batch = next;
+	}
+}
+
+bool EditQueue::Push( const EditOp& edit ) {
+	return Push( std::vector<EditOp>( 1, edit ) );
+}
+
+bool EditQueue::Push( std::vector<EditOp> edits ) {
+	if ( edits.empty( ) )
+		return false;
+	Batch* batch = new Batch;
+	batch->Edits = std::move( edits );
+	// The batch may be drained and freed the moment it is published, so the old
+	// head is kept in a local rather than read back from it
+	Batch* newest = head.load( std::memory_order_relaxed );
+	do {
+		batch->Next = newest;
+	} while ( !head.compare_exchange_weak( newest, batch, std::memory_order_release, std::memory_order_relaxed ) );
+	return newest == nullptr;
+}
+
+bool EditQueue::Empty( ) const {
+	return head.load( std::memory_order_acquire ) == nullptr;
+}
+
+void EditQueue::Drain( std::vector<EditOp>& out ) {
+	// Taking the whole list at once leaves nothing for ABA to bite on
+	Batch* batch = head.exchange( nullptr, std::memory_order_acquire );
+	Batch* oldest = nullptr;
+	while ( batch ) {
+		Batch* next = batch->Next;
+		batch->Next = oldest;
+		oldest = batch;
+		batch = next;
+	}
+	while ( oldest ) {
+		out.insert( out.end( ), oldest->Edits.begin( ), oldest->Edits.end( ) );
+		Batch* next = oldest->Next;
+		delete oldest;
+		oldest = next;
+	}
+}
+
+// Wrap or clip a span into the grid, as up to two spans within it
+static int NormalizeSpan( const Span& span, int width, int height, bool wrap, Span out[2] ) {
+	if ( span.X1 < span.X0 )
+		return 0;
+	if ( !wrap ) {
+		if ( span.Y < 0 || span.Y >= height )
+			return 0;
+		out[0] = { span.Y, std::max( span.X0, 0 ), std::min( span.X1, width - 1 ) };
+		return out[0].X0 <= out[0].X1;
+	}
+	int y = MOD_POSITIVE( span.Y, height );
+	int length = std::min( span.X1 - span.X0 + 1, width );
+	int start = MOD_POSITIVE( span.X0, width );
+	int first = std::min( length, width - start );
+	out[0] = { y, start, start + first - 1 };
+	if ( first == length )
+		return 1;
+	out[1] = { y, 0, length - first - 1 };
+	return 2;
+}
+
+void CoalesceSpans( const EditOp* begin, const EditOp* end, int width, int height, bool wrap, std::vector<EditOp>& out ) {
+	out.clear( );
+	if ( width <= 0 || height <= 0 )
+		return;
+	for ( const EditOp* edit = begin; edit != end; edit++ ) {
+		Span parts[2];
+		int count = NormalizeSpan( edit->Row, width, height, wrap, parts );
+		for ( int part = 0; part < count; part++ )
+			out.push_back( EditOp::FillSpan( parts[part], edit->Value ) );
+	}
+	// The stable sort keeps each row's fills in the order they were made
+	std::stable_sort( out.begin( ), out.end( ), []( const EditOp& a, const EditOp& b ) {
+		return a.Row.Y < b.Row.Y;
+	} );
+	size_t kept = 0;
+	for ( size_t i = 0; i < out.size( ); i++ ) {
+		const Span& span = out[i].Row;
+		if ( kept > 0 ) {
+			EditOp& last = out[kept - 1];
+			if ( last.Row.Y == span.Y && last.Value == out[i].Value
+				&& span.X0 <= last.Row.X1 + 1 && last.Row.X0 <= span.X1 + 1 ) {
+				last.Row.X0 = std::min( last.Row.X0, span.X0 );
+				last.Row.X1 = std::max( last.Row.X1, span.X1 );
+				continue;
+			}
+		}
+		out[kept++] = out[i];
+	}
+	out.resize( kept, EditOp( EditFillSpan ) );
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+// EditQueue.h
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "Brush.h"
+#include "Grid.h"
+#include "Region.h"
+
+enum EditType {
+	EditFillSpan,
+	EditFillRect,
+	EditFloodFill,
+	EditPaste,
+	EditRotate,
+	EditFlipHorizontal,
+	EditFlipVertical,
+	EditClear,
+	EditRandomize,
+	EditSetRules,
+	EditResize,
+	EditLoad,
+	EditStep,
+	EditSeek,
+	EditCheckpoint,
+	EditUndo,
+	EditRedo,
+	EditResetCounters
+};
+
+// One change to the grid, applied by the simulation thread between generations
+struct EditOp {
+	EditType Type;
+	Cell Value = 0;						// Cell value written by fills
+	union {
+		Span Row;
+		struct { int X, Y, Width, Height; } Rect;		// Also the region rotated or flipped
+		struct { int X, Y; } Point;
+		struct { int X, Y; Pattern* Cells; } Block;		// Cells are owned by the edit and freed once applied
+		struct { float Percent; int Iterations; bool HasSeed; uint32_t Seed; } Random;
+		struct { int Width, Height; } Size;
+		struct { int Width, Height; std::vector<Cell>* Cells; uint64_t Generation; uint32_t Seed; } World;	// Cells are owned like Block's
+		Rules NewRules;
+		struct { uint64_t Generation; } Rewind;
+	};
+
+	explicit EditOp( EditType type ) : Type( type ) { }
+
+	static EditOp FillSpan( const Span& span, Cell value );
+	static EditOp FillRect( int x, int y, int width, int height, Cell value );
+	static EditOp FloodFill( int x, int y, Cell value );
+	static EditOp Paste( int x, int y, Pattern pattern );
+	// Turn a region a quarter turn clockwise about its top-left cell
+	static EditOp Rotate( int x, int y, int width, int height );
+	static EditOp FlipHorizontal( int x, int y, int width, int height );
+	static EditOp FlipVertical( int x, int y, int width, int height );
+	static EditOp Clear( );
+	// Randomize, then run iterations ticks
+	static EditOp Randomize( float percent, int iterations );
+	// The same from a given seed, to recreate an earlier field
+	static EditOp Randomize( float percent, int iterations, uint32_t seed );
+	static EditOp SetRules( const Rules& rules );
+	static EditOp Resize( int width, int height );
+	// Replace the whole world, as read from a snapshot file
+	static EditOp Load( int width, int height, std::vector<Cell> cells, uint64_t generation, uint32_t seed );
+	static EditOp Step( );
+	// Go back to a generation kept in the history
+	static EditOp Seek( uint64_t generation );
+	// Remember the grid as it is now, for undo
+	static EditOp Checkpoint( );
+	static EditOp Undo( );
+	static EditOp Redo( );
+	static EditOp ResetCounters( );
+};
+
+// Lock-free queue of edits from any number of threads to the one that owns the
+// grid. Producers push whole batches with a single compare-and-swap; the
+// consumer takes everything queued with a single exchange and restores the
+// order, so neither side ever waits for the other.
+class EditQueue {
+public:
+	EditQueue( ) = default;
+	~EditQueue( );
+	EditQueue( const EditQueue& ) = delete;
+	EditQueue& operator=( const EditQueue& ) = delete;
+
+	// Queue edits to be applied in order. Returns true if the queue was empty,
+	// meaning the consumer may be asleep and should be woken.
+	bool Push( const EditOp& edit );
+	bool Push( std::vector<EditOp> edits );
+
+	bool Empty( ) const;
+
+	// Consumer only: append every queued edit to out, oldest first
+	void Drain( std::vector<EditOp>& out );
+
+private:
+	struct Batch {
+		std::vector<EditOp> Edits;
+		Batch* Next = nullptr;
+	};
+
+	std::atomic<Batch*> head{ nullptr };	// Newest batch first
+};
+
+// Merge a run of span fills into as few row fills as possible: the spans are
+// wrapped or clipped into the grid (so aliases of the same row meet), grouped
+// by row in their original order, and consecutive same-value spans that
+// overlap or touch are joined. Spans within the grid are written to out.
+void CoalesceSpans( const EditOp* begin, const EditOp* end, int width, int height, bool wrap, std::vector<EditOp>& out );
\ No newline at end of file
@@ -0,0 +1,34 @@
+// Engine.cpp
+
+#include "Engine.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Built on first use, since registrations in other files may run before this file's statics
+static std::vector<EngineInfo>& Registry( ) {
+	static std::vector<EngineInfo> engines;
+	return engines;
+}
+
+const std::vector<EngineInfo>& RegisteredEngines( ) {
+	return Registry( );
+}
+
+std::unique_ptr<Engine> CreateEngine( const std::string& name ) {
+	for ( const EngineInfo& info : Registry( ) ) {
+		if ( name == info.Name )
+			return info.Create( );
+	}
+	return nullptr;
+}
+
+EngineRegistration::EngineRegistration( const char* name, const char* description, EngineFactory create ) {
+	std::vector<EngineInfo>& engines = Registry( );
+	EngineInfo info = { name, description, create };
+	// Sorted, so the list doesn't depend on the order files are initialized in
+	auto at = std::lower_bound( engines.begin( ), engines.end( ), info, []( const EngineInfo& a, const EngineInfo& b ) {
+		return strcmp( a.Name, b.Name ) < 0;
+	} );
+	engines.insert( at, info );
+}
\ No newline at end of file
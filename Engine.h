@@ -0,0 +1,121 @@
+// Engine.h
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Grid.h"
+#include "Region.h"
+
+// Engine the simulation starts with
+static const char* const DefaultEngineName = "Reference";
+
+// A way of computing generations of a world. The simulation makes every edit
+// and reads every cell through its engine, between steps: history, undo,
+// look-ahead, export and drawing never touch the grid behind it. The grid
+// given to Attach is only where the world comes from and where Detach leaves
+// it, so an engine may keep cells in a form of its own in between.
+class Engine {
+public:
+	virtual ~Engine( ) = default;
+
+	// Take over grid's cells, rules and generation, until Detach
+	virtual void Attach( Grid& grid ) = 0;
+	// Leave everything in the grid for the next engine
+	virtual void Detach( ) = 0;
+
+	// Advance generations generations. Multithreaded is a hint; engines
+	// without a threaded path ignore it.
+	virtual void Step( int generations, bool multithreaded ) = 0;
+
+	virtual int GetWidth( ) = 0;
+	virtual int GetHeight( ) = 0;
+	virtual uint64_t GetGeneration( ) = 0;
+	// Seed of the last Randomize
+	virtual uint32_t GetSeed( ) = 0;
+
+	// Copy out a block with top-left cell (x, y), wrapping or clipping like Grid::CopyBlock
+	virtual void ReadRect( int x, int y, int width, int height, Pattern& out ) = 0;
+	// Set cells x0..x1 of row y, wrapping or clipping like Grid::FillSpan
+	virtual void WriteSpan( int y, int x0, int x1, Cell value ) = 0;
+	// Write a block with its top-left cell at (x, y), wrapping or clipping like Grid::PasteBlock
+	virtual void Paste( int x, int y, const Pattern& block ) = 0;
+	// Set the region connected to (x, y) that shares its value, like Grid::FloodFill
+	virtual void FloodFill( int x, int y, Cell value ) = 0;
+
+	// Replace the whole world
+	virtual void Load( int width, int height, const std::vector<Cell>& cells, uint64_t generation, uint32_t seed ) = 0;
+	// Start over with an empty world of a new size
+	virtual void Resize( int width, int height ) = 0;
+	virtual void Clear( ) = 0;
+	// Fill cells exactly as Grid::Randomize does, so a seed makes the same
+	// field whichever engine holds the world
+	virtual void Randomize( float percent, uint32_t seed ) = 0;
+
+	// The whole world as a grid checkpoint, for undo, look-ahead and export,
+	// and back from one. Checkpoints of an unchanged world share their bands.
+	virtual GridCheckpoint Checkpoint( ) = 0;
+	virtual void Restore( const GridCheckpoint& checkpoint ) = 0;
+
+	// Change stamps as Grid keeps them: RowStamp is the stamp at which row y
+	// last changed and AdvanceStamp moves on after the world has been copied.
+	// An engine that can't tell which rows changed returns GetStamp for all.
+	virtual uint64_t GetStamp( ) = 0;
+	virtual uint64_t RowStamp( int y ) = 0;
+	virtual void AdvanceStamp( ) = 0;
+
+	virtual void SetRules( const Rules& rules ) = 0;
+	virtual Rules GetRules( ) = 0;
+
+	// Cell ages and heat counted by the tick, as Grid counts them. Engines
+	// that don't count them keep these, and the simulation goes without.
+	virtual void TrackAges( bool /*track*/ ) { }
+	virtual bool TracksAges( ) { return false; }
+	virtual const uint8_t* AgeRow( int /*y*/ ) { return nullptr; }
+	virtual void TrackHeat( bool /*track*/ ) { }
+	virtual bool TracksHeat( ) { return false; }
+	virtual void SetHeatDecay( int /*decayShift*/ ) { }
+	// Heat of row y; rows follow each other in memory
+	virtual const uint8_t* HeatRow( int /*y*/ ) { return nullptr; }
+
+	// Live cells
+	virtual uint64_t Population( ) = 0;
+	// FNV-1a of the width and height as 32-bit values, then every cell row by
+	// row, so equal worlds hash equal whichever engine holds them
+	virtual uint64_t Hash( ) = 0;
+};
+
+static const uint64_t HashBasis = 14695981039346656037ull;
+
+// Fold size bytes into an FNV-1a hash
+inline uint64_t HashBytes( uint64_t hash, const void* data, size_t size ) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for ( size_t i = 0; i < size; i++ )
+		hash = ( hash ^ bytes[i] ) * 1099511628211ull;
+	return hash;
+}
+
+typedef std::unique_ptr<Engine> ( *EngineFactory )( );
+
+struct EngineInfo {
+	const char* Name;
+	const char* Description;			// Shown as a tooltip in the engine list
+	EngineFactory Create;
+};
+
+// Every registered engine, sorted by name
+const std::vector<EngineInfo>& RegisteredEngines( );
+
+// A new engine, or null if none is registered under name
+std::unique_ptr<Engine> CreateEngine( const std::string& name );
+
+// Registers an engine while static objects are constructed, so adding one
+// takes only a source file with a static EngineRegistration in it:
+//   static EngineRegistration registration( "Name", "What it does", [] ( ) -> std::unique_ptr<Engine> { ... } );
+class EngineRegistration {
+public:
+	EngineRegistration( const char* name, const char* description, EngineFactory create );
+};
\ No newline at end of file
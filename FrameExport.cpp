@@ -0,0 +1,327 @@
+// FrameExport.cpp
+
+#include "FrameExport.h"
+
+#include <raylib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include "Profiler.h"
+#include "SnapshotFile.h"
+
+ExportFormat ExportFormatFor( const std::string& path ) {
+	auto endsWith = [&path]( const char* extension ) {
+		const size_t length = strlen( extension );
+		return path.size( ) >= length && path.compare( path.size( ) - length, length, extension ) == 0;
+	};
+	if ( endsWith( ".y4m" ) )
+		return ExportY4m;
+	if ( endsWith( ".rgb" ) )
+		return ExportRawRgb;
+	return ExportPng;
+}
+
+// Numbered file for a frame of a PNG sequence: frames.png becomes frames_000042.png
+static std::string FramePath( const std::string& path, uint64_t index ) {
+	std::string stem = path;
+	if ( stem.size( ) >= 4 && stem.compare( stem.size( ) - 4, 4, ".png" ) == 0 )
+		stem.resize( stem.size( ) - 4 );
+	char number[32];
+	snprintf( number, sizeof( number ), "_%06llu.png", (unsigned long long)index );
+	return stem + number;
+}
+
+// Full-range BT.601 planes with chroma averaged over each 2 x 2 block, as Y4M's C420jpeg expects
+static void RgbaToYuv420( const uint32_t* pixels, int width, int height, uint8_t* out ) {
+	const uint8_t* rgba = (const uint8_t*)pixels;
+	const int chromaWidth = ( width + 1 ) / 2;
+	const int chromaHeight = ( height + 1 ) / 2;
+	uint8_t* luma = out;
+	uint8_t* blue = luma + (size_t)width * height;
+	uint8_t* red = blue + (size_t)chromaWidth * chromaHeight;
+	for ( size_t i = 0; i < (size_t)width * height; i++ ) {
+		const uint8_t* p = rgba + i * 4;
+		luma[i] = (uint8_t)( ( 19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768 ) >> 16 );
+	}
+	for ( int cy = 0; cy < chromaHeight; cy++ ) {
+		const int y0 = cy * 2;
+		const int y1 = std::min( y0 + 1, height - 1 );
+		for ( int cx = 0; cx < chromaWidth; cx++ ) {
+			const int x0 = cx * 2;
+			const int x1 = std::min( x0 + 1, width - 1 );
+			const uint8_t* corners[4] = {
+				rgba + ( (size_t)y0 * width + x0 ) * 4, rgba + ( (size_t)y0 * width + x1 ) * 4,
+				rgba + ( (size_t)y1 * width + x0 ) * 4, rgba + ( (size_t)y1 * width + x1 ) * 4 };
+			int r = 0, g = 0, b = 0;
+			for ( const uint8_t* p : corners ) {
+				r += p[0];
+				g += p[1];
+				b += p[2];
+			}
+			// Sums of four, so the coefficients are quartered
+			const size_t i = (size_t)cy * chromaWidth + cx;
+			blue[i] = (uint8_t)std::min( 255, ( -2765 * r - 5427 * g + 8192 * b + ( 128 << 16 ) + 32768 ) >> 16 );
+			red[i] = (uint8_t)std::min( 255, ( 8192 * r - 6860 * g - 1332 * b + ( 128 << 16 ) + 32768 ) >> 16 );
+		}
+	}
+}
+
+FrameExporter::~FrameExporter( ) {
+	std::string error;
+	Stop( error );
+}
+
+bool FrameExporter::Start( const ExportSettings& newSettings, int newWidth, int newHeight, std::string& error ) {
+	if ( active ) {
+		error = "Already exporting";
+		return false;
+	}
+	if ( newWidth <= 0 || newHeight <= 0 || newSettings.Scale < 1 || newSettings.Every < 1 || newSettings.QueueFrames < 1 ) {
+		error = "Nothing to export";
+		return false;
+	}
+	if ( (int64_t)newWidth * newHeight * newSettings.Scale * newSettings.Scale > MaxFramePixels ) {
+		error = "Frames would be too large; lower the scale";
+		return false;
+	}
+	settings = newSettings;
+	format = ExportFormatFor( settings.Path );
+	width = newWidth;
+	height = newHeight;
+	if ( format != ExportPng ) {
+		video = fopen( settings.Path.c_str( ), "wb" );
+		if ( !video ) {
+			error = "Could not open " + settings.Path;
+			return false;
+		}
+		if ( format == ExportY4m )
+			fprintf( video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width * settings.Scale, height * settings.Scale, settings.FrameRate );
+	}
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		queue.clear( );
+		inFlight = 0;
+		submitted = 0;
+		nextWrite = 0;
+		failure.clear( );
+		stopping = false;
+		accepting = true;
+	}
+	written = 0;
+	queued = 0;
+	stallMicroseconds = 0;
+	const int threads = settings.Threads > 0 ? settings.Threads : std::max( 1, (int)std::thread::hardware_concurrency( ) );
+	for ( int i = 0; i < threads; i++ )
+		workers.emplace_back( &FrameExporter::Work, this );
+	active = true;
+	return true;
+}
+
+void FrameExporter::Submit( Engine& engine ) {
+	std::unique_lock<std::mutex> lock( mutex );
+	const uint64_t generation = engine.GetGeneration( );
+	if ( !accepting || generation % settings.Every != 0 )
+		return;
+	if ( engine.GetWidth( ) != width || engine.GetHeight( ) != height ) {
+		// Every frame of a file has the same size
+		failure = "The world was resized during the export";
+		accepting = false;
+		return;
+	}
+	if ( inFlight >= settings.QueueFrames ) {
+		PROFILE_ZONE( "FrameExporter::Wait" );
+		auto start = std::chrono::steady_clock::now( );
+		room.wait( lock, [this] { return inFlight < settings.QueueFrames || !accepting; } );
+		stallMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now( ) - start ).count( );
+		if ( !accepting )
+			return;
+	}
+	// The checkpoint shares the engine's bands; it copies them if it writes them first
+	queue.push_back( { submitted++, generation, engine.Checkpoint( ) } );
+	inFlight++;
+	queued = inFlight;
+	work.notify_one( );
+}
+
+bool FrameExporter::Stop( std::string& error ) {
+	if ( !active )
+		return true;
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		accepting = false;
+		stopping = true;
+	}
+	work.notify_all( );
+	room.notify_all( );
+	for ( std::thread& worker : workers )
+		worker.join( );
+	workers.clear( );
+	if ( video ) {
+		if ( fclose( video ) != 0 && failure.empty( ) )
+			failure = "Could not write " + settings.Path;
+		video = nullptr;
+	}
+	queued = 0;
+	active = false;
+	error = failure;
+	return failure.empty( );
+}
+
+void FrameExporter::Fail( const std::string& error ) {
+	// Called with the mutex held. Only the first error is kept.
+	if ( failure.empty( ) )
+		failure = error;
+	accepting = false;
+	room.notify_all( );
+}
+
+void FrameExporter::Work( ) {
+	Profiler::SetThreadName( "Export" );
+	std::vector<uint32_t> pixels;
+	std::vector<uint8_t> bytes;
+	std::unique_lock<std::mutex> lock( mutex );
+	for ( ;; ) {
+		work.wait( lock, [this] { return !queue.empty( ) || stopping; } );
+		// Stopping only ends the workers once everything queued is out
+		if ( queue.empty( ) )
+			return;
+		Frame frame = std::move( queue.front( ) );
+		queue.pop_front( );
+		const bool failed = !failure.empty( );
+		lock.unlock( );
+
+		std::string error;
+		bool encoded = !failed && Encode( frame, pixels, bytes, error );
+		frame.Cells = GridCheckpoint( );
+		lock.lock( );
+		if ( !failed && !encoded )
+			Fail( error );
+		if ( video ) {
+			// Encoded in any order, written in order
+			turn.wait( lock, [this, &frame] { return nextWrite == frame.Index; } );
+			if ( encoded && failure.empty( ) ) {
+				lock.unlock( );
+				PROFILE_ZONE( "FrameExporter::Write" );
+				const bool wrote = ( format != ExportY4m || fputs( "FRAME\n", video ) >= 0 )
+					&& fwrite( bytes.data( ), 1, bytes.size( ), video ) == bytes.size( );
+				lock.lock( );
+				if ( !wrote )
+					Fail( "Could not write " + settings.Path );
+			}
+			nextWrite++;
+			turn.notify_all( );
+		}
+		if ( encoded && failure.empty( ) )
+			written++;
+		inFlight--;
+		queued = inFlight;
+		room.notify_one( );
+	}
+}
+
+bool FrameExporter::Encode( const Frame& frame, std::vector<uint32_t>& pixels, std::vector<uint8_t>& bytes, std::string& error ) {
+	PROFILE_ZONE( "FrameExporter::Encode" );
+	const GridCheckpoint& cells = frame.Cells;
+	const int scale = settings.Scale;
+	const int outWidth = cells.Width * scale;
+	const int outHeight = cells.Height * scale;
+	pixels.resize( (size_t)outWidth * outHeight );
+	for ( size_t band = 0; band < cells.Bands.size( ); band++ ) {
+		const int rows = (int)( cells.Bands[band]->size( ) / cells.Width );
+		uint32_t* out = pixels.data( ) + band * Grid::BandRows * scale * outWidth;
+		ExpandRows( cells.Bands[band]->data( ), cells.Width, 0, rows, scale, settings.Colors, out );
+	}
+	switch ( format ) {
+	case ExportY4m: {
+		const size_t chroma = (size_t)( ( outWidth + 1 ) / 2 ) * ( ( outHeight + 1 ) / 2 );
+		bytes.resize( pixels.size( ) + chroma * 2 );
+		RgbaToYuv420( pixels.data( ), outWidth, outHeight, bytes.data( ) );
+		return true;
+	}
+	case ExportRawRgb: {
+		bytes.resize( pixels.size( ) * 3 );
+		const uint8_t* rgba = (const uint8_t*)pixels.data( );
+		for ( size_t i = 0; i < pixels.size( ); i++ ) {
+			bytes[i * 3] = rgba[i * 4];
+			bytes[i * 3 + 1] = rgba[i * 4 + 1];
+			bytes[i * 3 + 2] = rgba[i * 4 + 2];
+		}
+		return true;
+	}
+	case ExportPng: {
+		const std::string path = FramePath( settings.Path, frame.Index );
+		Image image = { pixels.data( ), outWidth, outHeight, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+		if ( !ExportImage( image, path.c_str( ) ) ) {
+			error = "Could not write " + path;
+			return false;
+		}
+		return true;
+	}
+	}
+	return false;
+}
+
+bool FrameExporter::Active( ) const {
+	return active;
+}
+
+uint64_t FrameExporter::FramesWritten( ) const {
+	return written;
+}
+
+int FrameExporter::FramesQueued( ) const {
+	return queued;
+}
+
+double FrameExporter::StallSeconds( ) const {
+	return stallMicroseconds / 1e6;
+}
+
+std::string FrameExporter::GetError( ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	return failure;
+}
+
+int RunExport( const ExportSettings& settings, int width, int height, int generations, const std::string& worldPath ) {
+	// One line per PNG written is too much for a console
+	SetTraceLogLevel( LOG_WARNING );
+	Grid grid( width, height );
+	std::unique_ptr<Engine> engine = CreateEngine( DefaultEngineName );
+	engine->Attach( grid );
+	std::string error;
+	if ( !worldPath.empty( ) ) {
+		SnapshotInfo info;
+		std::vector<Cell> cells;
+		if ( !ReadSnapshotFile( worldPath, info, cells, error ) ) {
+			printf( "%s\n", error.c_str( ) );
+			return 1;
+		}
+		engine->Load( info.Width, info.Height, cells, info.Generation, info.Seed );
+		engine->SetRules( info.WorldRules );
+	} else {
+		engine->Randomize( 0.5f, std::random_device( )( ) );
+	}
+
+	FrameExporter exporter;
+	if ( !exporter.Start( settings, engine->GetWidth( ), engine->GetHeight( ), error ) ) {
+		printf( "%s\n", error.c_str( ) );
+		return 1;
+	}
+	auto start = std::chrono::steady_clock::now( );
+	exporter.Submit( *engine );
+	for ( int i = 0; i < generations; i++ ) {
+		engine->Step( 1, true );
+		exporter.Submit( *engine );
+	}
+	const bool exported = exporter.Stop( error );
+	double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+	printf( "Exported %llu frames of %dx%d to %s in %.2f s, %.2f s of it waiting for the encoders\n",
+		(unsigned long long)exporter.FramesWritten( ), engine->GetWidth( ) * settings.Scale, engine->GetHeight( ) * settings.Scale,
+		settings.Path.c_str( ), seconds, exporter.StallSeconds( ) );
+	if ( !exported )
+		printf( "%s\n", error.c_str( ) );
+	return exported ? 0 : 1;
+}
\ No newline at end of file
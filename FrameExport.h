@@ -0,0 +1,115 @@
+// FrameExport.h
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Engine.h"
+#include "Grid.h"
+#include "PixelExpand.h"
+
+enum ExportFormat {
+	ExportY4m,		// YUV4MPEG2 video, 4:2:0, in one file
+	ExportRawRgb,	// Headerless 24-bit RGB frames in one file
+	ExportPng		// A numbered PNG per frame
+};
+
+struct ExportSettings {
+	std::string Path;				// .y4m or .rgb for video, anything else a PNG sequence
+	int Every = 1;					// Export the generations that are multiples of this
+	int Scale = 1;					// Pixels per cell side
+	Palette Colors;					// Pixel color of each cell value
+	int FrameRate = 30;				// Stated in the Y4M header
+	int QueueFrames = 8;			// Frames queued or encoding before Submit waits
+	int Threads = 0;				// Encoder threads, or 0 for one per core
+};
+
+// Format implied by the extension of path
+ExportFormat ExportFormatFor( const std::string& path );
+
+// Renders generations into pixels and writes them out on a pool of encoder
+// threads. Frames hold a checkpoint of the grid rather than a copy, and a
+// bounded queue makes the producer wait for the encoders instead of dropping
+// frames. Video frames are encoded in parallel and written in order; PNG
+// frames are written by whichever thread encodes them.
+// Submit belongs to one producer thread and Start and Stop to one controlling
+// thread; the counters and error may be read from any thread.
+class FrameExporter {
+public:
+	// Largest frame, in pixels, an export may produce
+	static const int64_t MaxFramePixels = (int64_t)1 << 26;
+
+	FrameExporter( ) = default;
+	FrameExporter( const FrameExporter& ) = delete;
+	FrameExporter& operator=( const FrameExporter& ) = delete;
+	~FrameExporter( );
+
+	// Open the output for width x height worlds and start the encoders.
+	// Returns false with a reason in error if it can't.
+	bool Start( const ExportSettings& settings, int width, int height, std::string& error );
+
+	// Queue the engine's current generation if it is one to export, waiting
+	// while the queue is full. Does nothing when not exporting.
+	void Submit( Engine& engine );
+
+	// Write out every queued frame and close the output. Returns false with
+	// the first write error, or the reason the export stopped early, in error.
+	bool Stop( std::string& error );
+
+	bool Active( ) const;
+	uint64_t FramesWritten( ) const;
+	int FramesQueued( ) const;
+	double StallSeconds( ) const;		// Time Submit has spent waiting for room
+	// Why the export stopped taking frames early, or empty if it hasn't
+	std::string GetError( );
+
+private:
+	struct Frame {
+		uint64_t Index;
+		uint64_t Generation;
+		GridCheckpoint Cells;
+	};
+
+	void Work( );
+	// Pixels of frame into bytes in the output format; false with error if a
+	// PNG couldn't be written
+	bool Encode( const Frame& frame, std::vector<uint32_t>& pixels, std::vector<uint8_t>& bytes, std::string& error );
+	void Fail( const std::string& error );
+
+	ExportSettings settings;
+	ExportFormat format = ExportPng;
+	int width = 0;
+	int height = 0;
+	FILE* video = nullptr;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;					// Guards everything below up to the atomics
+	std::condition_variable room;		// Signalled when a frame finishes
+	std::condition_variable work;		// Signalled when a frame is queued or the export ends
+	std::condition_variable turn;		// Signalled when a video frame is written
+	std::deque<Frame> queue;
+	int inFlight = 0;					// Queued plus encoding
+	uint64_t submitted = 0;
+	uint64_t nextWrite = 0;				// Index of the next video frame to write
+	bool accepting = false;
+	bool stopping = false;
+	std::string failure;
+
+	std::atomic<bool> active{ false };
+	std::atomic<uint64_t> written{ 0 };
+	std::atomic<int> queued{ 0 };
+	std::atomic<uint64_t> stallMicroseconds{ 0 };
+};
+
+// Export generations of a world without opening a window: a random field of
+// width x height, or the snapshot at worldPath if one is given. Returns
+// nonzero if the export fails.
+int RunExport( const ExportSettings& settings, int width, int height, int generations, const std::string& worldPath );
\ No newline at end of file
@@ -1,20 +1,35 @@
 // Grid.cpp
 
 #include "Grid.h"
+#include "Heatmap.h"
+#include "Profiler.h"
+#include "Region.h"
 
+#include <algorithm>
+#include <cstring>
+#include <random>
 #include <thread>
 #include <iostream>
 
+bool Rules::operator==( const Rules& other ) const {
+	return EdgeBehavior == other.EdgeBehavior
+		&& std::equal( Neighborhood, Neighborhood + 8, other.Neighborhood )
+		&& std::equal( BirthRule, BirthRule + 9, other.BirthRule )
+		&& std::equal( SurviveRule, SurviveRule + 9, other.SurviveRule );
+}
+
 Grid::Grid( int width, int height ) {
 	for ( size_t i = 0; i < 8; i++ )
 		Neighborhood[i] = true;
-	BirthRule[3] = 1;
-	SurviveRule[3] = 1;
-	SurviveRule[2] = 1;
+	// Conway's B3/S23 until rules are set
+	for ( int i = 0; i < 9; i++ ) {
+		BirthRule[i] = i == 3;
+		SurviveRule[i] = i == 2 || i == 3;
+	}
 	Width = width;
 	Height = height;
-	Front.resize( static_cast<std::vector<Cell, std::allocator<Cell>>::size_type>( width ) * height );
-	Back.resize( Front.size( ) );
+	AllocateBands( );
+	RowStamps.resize( height, Stamp );
 }
 
 int Grid::GetWidth( ) {
@@ -40,9 +55,11 @@ void Grid::Resize( int newWidth, int newHeight ) {
 	*/	
 	Width = newWidth;
 	Height = newHeight;
-	Front.resize( static_cast<std::vector<Cell, std::allocator<Cell>>::size_type>( newWidth ) * newHeight, 0 );
-	Back.resize( Front.size( ), 0 );
-	Clear( );
+	AllocateBands( );
+	RowStamps.resize( newHeight );
+	MarkAll( );
+	ResetAges( );
+	ResetHeat( );
 	/*
 	for ( size_t y = 0; y < cloneHeight; y++ ) {
 		for ( size_t x = 0; x < cloneWidth; x++ ) {
@@ -52,90 +69,365 @@ void Grid::Resize( int newWidth, int newHeight ) {
 	*/
 }
 
+void Grid::Load( int width, int height, const std::vector<Cell>& cells ) {
+	Width = width;
+	Height = height;
+	AllocateBands( );
+	for ( int band = 0; band < BandCount( ); band++ ) {
+		const Cell* source = cells.data( ) + (size_t)band * BandRows * Width;
+		std::copy( source, source + Front[band]->size( ), Front[band]->begin( ) );
+	}
+	RowStamps.assign( height, Stamp );
+	ResetAges( );
+	ResetHeat( );
+}
+
+GridCheckpoint Grid::Checkpoint( ) {
+	return { Width, Height, Generation, Seed, Front };
+}
+
+void Grid::Restore( const GridCheckpoint& checkpoint ) {
+	if ( checkpoint.Width != Width || checkpoint.Height != Height ) {
+		spares.clear( );
+		Width = checkpoint.Width;
+		Height = checkpoint.Height;
+		RowStamps.assign( Height, Stamp );
+		ResetHeat( );
+	} else {
+		// Only bands that aren't already the checkpoint's have changed
+		for ( int band = 0; band < BandCount( ); band++ ) {
+			if ( Front[band] != checkpoint.Bands[band] )
+				std::fill_n( RowStamps.begin( ) + band * BandRows, BandHeight( band ), Stamp );
+		}
+	}
+	Generation = checkpoint.Generation;
+	Seed = checkpoint.Seed;
+	Front = checkpoint.Bands;
+	Back = Front;
+	if ( tracksAges ) {
+		// Ages of the restored cells are unknown, so every row starts over
+		ResetAges( );
+		MarkAll( );
+	}
+}
+
+void Grid::AllocateBands( ) {
+	spares.clear( );
+	Front.resize( BandCount( ) );
+	for ( int band = 0; band < BandCount( ); band++ )
+		Front[band] = std::make_shared<std::vector<Cell>>( (size_t)BandHeight( band ) * Width, 0 );
+	// Back gets buffers of its own on the first tick
+	Back = Front;
+}
+
+int Grid::BandCount( ) {
+	return ( Height + BandRows - 1 ) / BandRows;
+}
+
+int Grid::BandHeight( int band ) {
+	return std::min( BandRows, Height - band * BandRows );
+}
+
+CellBand Grid::NewBand( int band ) {
+	const size_t size = (size_t)BandHeight( band ) * Width;
+	if ( !spares.empty( ) && spares.back( )->size( ) == size ) {
+		CellBand spare = std::move( spares.back( ) );
+		spares.pop_back( );
+		return spare;
+	}
+	return std::make_shared<std::vector<Cell>>( size );
+}
+
+void Grid::MakeWritable( int band, bool keepCells ) {
+	if ( Front[band].use_count( ) == 1 )
+		return;
+	CellBand copy = NewBand( band );
+	if ( keepCells )
+		std::copy( Front[band]->begin( ), Front[band]->end( ), copy->begin( ) );
+	Front[band] = std::move( copy );
+}
+
+Cell* Grid::WritableRow( int y ) {
+	MakeWritable( y / BandRows, true );
+	return Front[y / BandRows]->data( ) + (size_t)( y % BandRows ) * Width;
+}
+
+Rules Grid::GetRules( ) {
+	Rules rules;
+	rules.EdgeBehavior = EdgeBehavior;
+	std::copy( Neighborhood, Neighborhood + 8, rules.Neighborhood );
+	std::copy( BirthRule, BirthRule + 9, rules.BirthRule );
+	std::copy( SurviveRule, SurviveRule + 9, rules.SurviveRule );
+	return rules;
+}
+
+void Grid::SetRules( const Rules& rules ) {
+	EdgeBehavior = rules.EdgeBehavior;
+	std::copy( rules.Neighborhood, rules.Neighborhood + 8, Neighborhood );
+	std::copy( rules.BirthRule, rules.BirthRule + 9, BirthRule );
+	std::copy( rules.SurviveRule, rules.SurviveRule + 9, SurviveRule );
+}
+
+const Cell* Grid::Row( int y ) {
+	return Front[y / BandRows]->data( ) + (size_t)( y % BandRows ) * Width;
+}
+
+uint64_t Grid::GetStamp( ) {
+	return Stamp;
+}
+
+void Grid::AdvanceStamp( ) {
+	Stamp++;
+}
+
+uint64_t Grid::RowStamp( int y ) {
+	return RowStamps[y];
+}
+
+void Grid::MarkAll( ) {
+	std::fill( RowStamps.begin( ), RowStamps.end( ), Stamp );
+}
+
+void Grid::TrackAges( bool enabled ) {
+	if ( enabled == tracksAges )
+		return;
+	tracksAges = enabled;
+	if ( enabled ) {
+		ResetAges( );
+		MarkAll( );
+	} else {
+		Ages = std::vector<uint8_t>( );
+	}
+}
+
+bool Grid::TracksAges( ) {
+	return tracksAges;
+}
+
+const uint8_t* Grid::AgeRow( int y ) {
+	return Ages.data( ) + (size_t)y * Width;
+}
+
+void Grid::ResetAges( ) {
+	if ( tracksAges )
+		Ages.assign( (size_t)Width * Height, 0 );
+}
+
+void Grid::TrackHeat( bool enabled ) {
+	if ( enabled == tracksHeat )
+		return;
+	tracksHeat = enabled;
+	if ( enabled )
+		ResetHeat( );
+	else
+		Heat = std::vector<uint8_t>( );
+}
+
+bool Grid::TracksHeat( ) {
+	return tracksHeat;
+}
+
+void Grid::SetHeatDecay( int decayShift ) {
+	heatDecay = std::min( std::max( decayShift, 1 ), 8 );
+}
+
+const uint8_t* Grid::HeatRow( int y ) {
+	return Heat.data( ) + (size_t)y * Width;
+}
+
+void Grid::ResetHeat( ) {
+	if ( tracksHeat )
+		Heat.assign( (size_t)Width * Height, 0 );
+}
+
 inline bool Grid::InGrid( int x, int y ) {
 	return ( x >= 0 ) && ( y >= 0 ) && ( x < Width ) && ( y < Height );
 }
 
-int Grid::Convolute( int x, int y ) {
+int Grid::Convolute( int x, const Cell* const rows[3] ) {
 	int sum = 0;
 	const int x_lookup[] = { -1, 0, 1, -1, 1, -1, 0, 1 };
 	const int y_lookup[] = { -1, -1, -1, 0, 0, 1, 1, 1 };
 	for ( size_t i = 0; i < 8; i++ ) {
 		if ( !Neighborhood[i] ) continue;
-		int dx = x_lookup[i];
-		int dy = y_lookup[i];
-		int xx = x + dx;
-		int yy = y + dy;
+		const Cell* row = rows[y_lookup[i] + 1];
+		if ( !row ) continue;
+		int xx = x + x_lookup[i];
 
 		// Boundary check
-		if ( InGrid( xx, yy ) ) {
-			// Avoid function call to Get, directly access Front vector
-			sum += Front[GetIdx( xx, yy )];
+		if ( xx >= 0 && xx < Width ) {
+			sum += row[xx];
 		} else if ( EdgeBehavior == Wrap ) {
 			// If wrapping is enabled, adjust coordinates accordingly
-			sum += Front[GetIdx( MOD_POSITIVE( xx, Width ), MOD_POSITIVE( yy, Height ) )];
+			sum += row[MOD_POSITIVE( xx, Width )];
 		}
 	}
 	return sum;
 }
 
+void Grid::TickBands( int startBand, int endBand ) {
+	for ( int band = startBand; band < endBand; band++ ) {
+		Cell* out = Back[band]->data( );
+		bool bandDiffers = false;
+		for ( int y = band * BandRows; y < band * BandRows + BandHeight( band ); y++ ) {
+			// Rows above and below, wrapped or missing past the edges
+			const Cell* rows[3];
+			for ( int dy = -1; dy <= 1; dy++ ) {
+				int yy = y + dy;
+				if ( yy >= 0 && yy < Height )
+					rows[dy + 1] = Row( yy );
+				else
+					rows[dy + 1] = EdgeBehavior == Wrap ? Row( MOD_POSITIVE( yy, Height ) ) : nullptr;
+			}
+			const Cell* row = rows[1];
+			Cell* target = out + (size_t)( y - band * BandRows ) * Width;
+			bool changed = false;
+			bool aged = false;
+			if ( tracksAges ) {
+				// Ages follow from each cell's old and new state, so they are
+				// counted in place in the same pass
+				uint8_t* age = Ages.data( ) + (size_t)y * Width;
+				for ( int x = 0; x < Width; x++ ) {
+					int c = Convolute( x, rows );
+					target[x] = row[x] ? SurviveRule[c] : BirthRule[c];
+					changed |= target[x] != row[x];
+					uint8_t next = target[x] ? ( row[x] ? age[x] + ( age[x] < 255 ) : 1 ) : 0;
+					aged |= next != age[x];
+					age[x] = next;
+				}
+			} else {
+				for ( int x = 0; x < Width; x++ ) {
+					int c = Convolute( x, rows );
+					target[x] = row[x] ? SurviveRule[c] : BirthRule[c];
+					changed |= target[x] != row[x];
+				}
+			}
+			if ( tracksHeat )
+				AccumulateHeat( Heat.data( ) + (size_t)y * Width, row, target, Width, heatDecay );
+			// Rows belong to one thread each, so this needs no synchronization
+			if ( changed || aged )
+				RowStamps[y] = Stamp;
+			bandDiffers |= changed;
+		}
+		bandChanged[band] = bandDiffers;
+	}
+}
+
+void Grid::PrepareBack( ) {
+	Back.resize( BandCount( ) );
+	bandChanged.assign( BandCount( ), 0 );
+	for ( int band = 0; band < BandCount( ); band++ ) {
+		if ( !Back[band] || Back[band].use_count( ) > 1 )
+			Back[band] = NewBand( band );
+	}
+}
+
+void Grid::FinishTick( ) {
+	// A band the tick left as it was is shared instead, and its buffer kept
+	// for the next band that needs one
+	for ( int band = 0; band < BandCount( ); band++ ) {
+		if ( bandChanged[band] )
+			continue;
+		if ( spares.size( ) < Front.size( ) )
+			spares.push_back( std::move( Back[band] ) );
+		Back[band] = Front[band];
+	}
+	std::swap( Front, Back );
+	Generation++;
+}
+
 void Grid::TickWithMultithreading( ) {
+	PROFILE_ZONE( "Grid::TickWithMultithreading" );
 	const int numThreads = std::thread::hardware_concurrency( );
-	const int chunkSize = Height / numThreads;
+	const int bands = BandCount( );
+	PrepareBack( );
 
 	std::vector<std::thread> threads( numThreads );
+	TickRecord& record = Timeline.Begin( numThreads + 1 );
+	std::vector<uint64_t> busyStart( numThreads );
+	std::vector<uint64_t> busyEnd( numThreads );
+	uint64_t* starts = busyStart.data( );
+	uint64_t* ends = busyEnd.data( );
 
 	for ( int i = 0; i < numThreads; i++ ) {
 		threads[i] = std::thread( [=]( ) {
-			// Compute start and end rows for this thread
-			int startRow = i * chunkSize;
-			int endRow = ( i == numThreads - 1 ) ? Height : ( i + 1 ) * chunkSize;
+			starts[i] = Profiler::Now( );
+			if ( Profiler::IsCapturing( ) )
+				Profiler::SetThreadLane( "Grid worker", i );
+			PROFILE_ZONE( "Grid worker" );
+			// Compute start and end bands for this thread
+			int startBand = bands * i / numThreads;
+			int endBand = bands * ( i + 1 ) / numThreads;
 			// Update cells for this portion of the grid
-			for ( int y = startRow; y < endRow; y++ ) {
-				for ( int x = 0; x < Width; x++ ) {
-					int c = Convolute( x, y );
-					int i = y * Width + x;
-					Back[i] = Front[i] ? SurviveRule[c] : BirthRule[c];
-				}
-			}
+			TickBands( startBand, endBand );
+			ends[i] = Profiler::Now( );
 		} );
 	}
+	uint64_t spawned = Profiler::Now( );
 
 	for ( auto& thread : threads ) thread.join( );
+	uint64_t joined = Profiler::Now( );
 
-	std::swap( Front, Back );
+	FinishTick( );
+
+	record.segments.push_back( { 0, LaneBusy, record.start, spawned } );
+	record.segments.push_back( { 0, LaneIdle, spawned, joined } );
+	record.segments.push_back( { 0, LaneBusy, joined, Profiler::Now( ) } );
+	for ( int i = 0; i < numThreads; i++ ) {
+		record.segments.push_back( { i + 1, LaneBusy, busyStart[i], busyEnd[i] } );
+		record.segments.push_back( { i + 1, LaneIdle, busyEnd[i], joined } );
+	}
+	Timeline.Commit( );
 }
 
 void Grid::Tick( ) {
-	for ( size_t i = 0; i < Front.size( ); i++ ) {
-		int c = Convolute( GetX( i ), GetY( i ) );
-		Back[i] = Front[i] ? SurviveRule[c] : BirthRule[c];
-	}
-	std::swap( Front, Back );
+	PROFILE_ZONE( "Grid::Tick" );
+	TickRecord& record = Timeline.Begin( 1 );
+	PrepareBack( );
+	TickBands( 0, BandCount( ) );
+	FinishTick( );
+	record.segments.push_back( { 0, LaneBusy, record.start, Profiler::Now( ) } );
+	Timeline.Commit( );
 }
 
 void Grid::Randomize( ) {
-	for ( size_t i = 0; i < Front.size( ); i++ ) {
-		Front[i] = rand( ) % 2;
-	}
+	Randomize( 0.5f );
+}
+
+void Grid::Randomize( float percent ) {
+	Randomize( percent, std::random_device( )( ) );
 }
 
-void Grid::Randomize( float percent = 0.5f ) {
-	for ( size_t i = 0; i < Front.size( ); i++ ) {
-		Front[i] = static_cast <float> ( rand( ) ) / static_cast <float> ( RAND_MAX ) < percent;
+void Grid::Randomize( float percent, uint32_t seed ) {
+	// A generator of its own, so other threads' rand calls can't change the field.
+	// The top 24 bits make a float exactly, the same on every platform.
+	Seed = seed;
+	std::mt19937 random( seed );
+	for ( int band = 0; band < BandCount( ); band++ ) {
+		MakeWritable( band, false );
+		for ( Cell& cell : *Front[band] )
+			cell = ( random( ) >> 8 ) * ( 1.0f / 16777216.0f ) < percent;
 	}
+	MarkAll( );
+	ResetAges( );
 }
 
 void Grid::Clear( ) {
-	for ( size_t i = 0; i < Front.size( ); i++ ) {
-		Front[i] = false;
+	for ( int band = 0; band < BandCount( ); band++ ) {
+		MakeWritable( band, false );
+		std::fill( Front[band]->begin( ), Front[band]->end( ), 0 );
 	}
+	MarkAll( );
+	ResetAges( );
 }
 
 void Grid::Fill( ) {
-	for ( size_t i = 0; i < Front.size( ); i++ ) {
-		Front[i] = true;
+	for ( int band = 0; band < BandCount( ); band++ ) {
+		MakeWritable( band, false );
+		std::fill( Front[band]->begin( ), Front[band]->end( ), 1 );
 	}
+	MarkAll( );
+	ResetAges( );
 }
 
 inline int Grid::GetIdx( int x, int y ) {
@@ -155,7 +447,7 @@ inline int Grid::GetY( int i ) {
 Cell Grid::Get( int x, int y ) {
 	if ( InGrid( x, y ) || EdgeBehavior == Wrap ) {
 		// If the cell is within the grid or wrapping is enabled, return the cell value
-		return Front[GetIdx( MOD_POSITIVE( x, Width ), MOD_POSITIVE( y, Height ) )];
+		return Row( MOD_POSITIVE( y, Height ) )[MOD_POSITIVE( x, Width )];
 	} else {
 		// If the cell is outside the grid and wrapping is disabled, return the default cell value (AlwaysOn)
 		return EdgeBehavior == AlwaysOn ? 1 : 0; // Assuming 1 represents "Alive" and 0 represents "Dead"
@@ -163,16 +455,162 @@ Cell Grid::Get( int x, int y ) {
 }
 
 
-Cell Grid::GetBack( int x, int y ) {
-	return ( InGrid( x, y ) || EdgeBehavior == Wrap ) ? Back[GetIdx( MOD_POSITIVE( x, Width ), MOD_POSITIVE( y, Height ) )] : EdgeBehavior == AlwaysOn;
+void Grid::Set( int x, int y, Cell value ) {
+	if ( InGrid( x, y ) || EdgeBehavior == Wrap ) {
+		int wrappedY = MOD_POSITIVE( y, Height );
+		WritableRow( wrappedY )[MOD_POSITIVE( x, Width )] = value;
+		RowStamps[wrappedY] = Stamp;
+	}
 }
 
-void Grid::Set( int x, int y, Cell value ) {
-	if ( InGrid( x, y ) || EdgeBehavior == Wrap )
-		Front[GetIdx( MOD_POSITIVE( x, Width ), MOD_POSITIVE( y, Height ) )] = value;
+void Grid::FillSpan( int y, int x0, int x1, Cell value ) {
+	if ( x1 < x0 )
+		return;
+	if ( EdgeBehavior == Wrap ) {
+		y = MOD_POSITIVE( y, Height );
+		Cell* row = WritableRow( y );
+		int length = std::min( x1 - x0 + 1, Width );
+		int start = MOD_POSITIVE( x0, Width );
+		// A span running off the right edge continues from the left
+		int first = std::min( length, Width - start );
+		std::fill( row + start, row + start + first, value );
+		std::fill( row, row + length - first, value );
+	} else {
+		if ( y < 0 || y >= Height )
+			return;
+		x0 = std::max( x0, 0 );
+		x1 = std::min( x1, Width - 1 );
+		if ( x1 < x0 )
+			return;
+		Cell* row = WritableRow( y );
+		std::fill( row + x0, row + x1 + 1, value );
+	}
+	RowStamps[y] = Stamp;
+}
+
+void Grid::FloodFill( int x, int y, Cell value ) {
+	PROFILE_ZONE( "Grid::FloodFill" );
+	const bool wrap = EdgeBehavior == Wrap;
+	if ( wrap ) {
+		x = MOD_POSITIVE( x, Width );
+		y = MOD_POSITIVE( y, Height );
+	} else if ( !InGrid( x, y ) ) {
+		return;
+	}
+	const Cell target = Row( y )[x];
+	if ( target == value )
+		return;
+	// Scanline fill: each seed is grown into the widest run of target cells on
+	// its row, the run is filled, and the rows above and below are scanned under
+	// it for runs to seed. Runs are kept as unwrapped x ranges at most Width long.
+	// Cells are 0 or 1, so the end of a run is the next cell of the other value
+	// and memchr can find both.
+	const Cell other = target ^ 1;
+	auto column = [this]( int cx ) {
+		return cx < 0 ? cx + Width : cx >= Width ? cx - Width : cx;
+	};
+	struct Seed {
+		int X;
+		int Y;
+	};
+	std::vector<Seed> stack;
+	stack.push_back( { x, y } );
+	while ( !stack.empty( ) ) {
+		Seed seed = stack.back( );
+		stack.pop_back( );
+		const Cell* row = Row( seed.Y );
+		if ( row[seed.X] != target )
+			continue;
+		int left = seed.X;
+		int right = seed.X;
+		if ( wrap ) {
+			// Right to the end of the row, then on from its start
+			const Cell* end = (const Cell*)memchr( row + seed.X, other, Width - seed.X );
+			if ( end ) {
+				right = (int)( end - row ) - 1;
+			} else {
+				end = (const Cell*)memchr( row, other, seed.X );
+				right = end ? Width + (int)( end - row ) - 1 : seed.X + Width - 1;
+			}
+			while ( right - left + 1 < Width && row[column( left - 1 )] == target )
+				left--;
+		} else {
+			while ( left > 0 && row[left - 1] == target )
+				left--;
+			const Cell* end = (const Cell*)memchr( row + seed.X, other, Width - seed.X );
+			right = end ? (int)( end - row ) - 1 : Width - 1;
+		}
+		FillSpan( seed.Y, left, right, value );
+		// The run as up to two in-row segments, split where it wraps
+		int segments[2][2] = { { column( left ), column( left ) + right - left }, { 0, -1 } };
+		if ( segments[0][1] >= Width ) {
+			segments[1][1] = segments[0][1] - Width;
+			segments[0][1] = Width - 1;
+		}
+		for ( int dy = -1; dy <= 1; dy += 2 ) {
+			int ny = seed.Y + dy;
+			if ( wrap )
+				ny = MOD_POSITIVE( ny, Height );
+			else if ( ny < 0 || ny >= Height )
+				continue;
+			const Cell* next = Row( ny );
+			for ( const auto& segment : segments ) {
+				const Cell* cell = next + segment[0];
+				const Cell* end = next + segment[1] + 1;
+				while ( cell < end ) {
+					cell = (const Cell*)memchr( cell, target, end - cell );
+					if ( !cell )
+						break;
+					stack.push_back( { (int)( cell - next ), ny } );
+					const Cell* runEnd = (const Cell*)memchr( cell, other, end - cell );
+					cell = runEnd ? runEnd : end;
+				}
+			}
+		}
+	}
 }
 
-void Grid::SetBack( int x, int y, Cell value ) {
-	if ( InGrid( x, y ) || EdgeBehavior == Wrap )
-		Back[GetIdx( MOD_POSITIVE( x, Width ), MOD_POSITIVE( y, Height ) )] = value;
+void Grid::CopyBlock( int x, int y, int width, int height, Pattern& out ) {
+	// A block inside the grid is copied row by row, without a table of every row
+	if ( x >= 0 && y >= 0 && width >= 0 && height >= 0 && x + width <= Width && y + height <= Height ) {
+		out.Width = width;
+		out.Height = height;
+		out.Cells.resize( (size_t)width * height );
+		for ( int row = 0; row < height; row++ )
+			std::copy( Row( y + row ) + x, Row( y + row ) + x + width, out.Cells.begin( ) + (size_t)row * width );
+		return;
+	}
+	std::vector<const Cell*> rows( Height );
+	for ( int row = 0; row < Height; row++ )
+		rows[row] = Row( row );
+	::CopyBlock( rows.data( ), Width, Height, EdgeBehavior == Wrap, x, y, width, height, out );
+}
+
+void Grid::PasteBlock( int x, int y, const Pattern& pattern ) {
+	const bool wrap = EdgeBehavior == Wrap;
+	for ( int row = 0; row < pattern.Height; row++ ) {
+		int targetY = y + row;
+		if ( wrap )
+			targetY = MOD_POSITIVE( targetY, Height );
+		else if ( targetY < 0 || targetY >= Height )
+			continue;
+		const Cell* source = pattern.Cells.data( ) + (size_t)row * pattern.Width;
+		Cell* target = WritableRow( targetY );
+		int column = 0;
+		while ( column < pattern.Width ) {
+			int targetX = x + column;
+			if ( wrap ) {
+				targetX = MOD_POSITIVE( targetX, Width );
+			} else if ( targetX < 0 ) {
+				column = -x;
+				continue;
+			} else if ( targetX >= Width ) {
+				break;
+			}
+			int length = std::min( pattern.Width - column, Width - targetX );
+			std::copy( source + column, source + column + length, target + targetX );
+			column += length;
+		}
+		RowStamps[targetY] = Stamp;
+	}
 }
\ No newline at end of file
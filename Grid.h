@@ -1,8 +1,12 @@
 // Grid.h
 
 #pragma once
+#include <cstdint>
+#include <memory>
 #include <vector>
 
+#include "Timeline.h"
+
 // Computes the modulus operation with a positive result even for negative numbers.
 #define MOD_POSITIVE(a,b) (((a)%(b))+(b))%(b)
 
@@ -14,8 +18,42 @@ enum WrapSetting {
 
 typedef unsigned char Cell;
 
+struct Pattern;
+
+// Everything that decides how the grid evolves, apart from the cells themselves
+struct Rules {
+	WrapSetting EdgeBehavior = Wrap;
+	bool Neighborhood[8];
+	char BirthRule[9];
+	char SurviveRule[9];
+
+	bool operator==( const Rules& other ) const;
+	bool operator!=( const Rules& other ) const { return !( *this == other ); }
+};
+
+// Cells of a band of whole rows. Bands are shared between the grid, its back
+// buffer and any checkpoints, and copied only when written while shared.
+typedef std::shared_ptr<std::vector<Cell>> CellBand;
+
+// A saved grid state. Taking one copies band pointers, not cells.
+struct GridCheckpoint {
+	int Width = 0;
+	int Height = 0;
+	uint64_t Generation = 0;
+	uint32_t Seed = 0;
+	std::vector<CellBand> Bands;
+};
+
+// Whether two checkpoints are the same state, sharing all their bands
+inline bool SameCheckpoint( const GridCheckpoint& a, const GridCheckpoint& b ) {
+	return a.Width == b.Width && a.Height == b.Height && a.Generation == b.Generation && a.Bands == b.Bands;
+}
+
 class Grid {
 public:
+	// Rows per band: the unit of sharing and of copying on write
+	static constexpr int BandRows = 16;
+
 	Grid( int width, int height );
 	WrapSetting EdgeBehavior = Wrap;
 	bool Neighborhood[8];
@@ -27,21 +65,94 @@ public:
 	void Tick( );
 	void Randomize( );
 	void Randomize( float percent );
+	// Fill from a generator seeded with seed; the same seed, percent and size
+	// always give the same field
+	void Randomize( float percent, uint32_t seed );
 	void Fill( );
 	void Clear( );
 	Cell Get( int x, int y );
 	void Set( int x, int y, Cell value );
+	// Set cells x0..x1 of row y, wrapping or clipping like Set
+	void FillSpan( int y, int x0, int x1, Cell value );
+	// Set the region connected to (x, y) that shares its value, through edges
+	// and across them when wrapping
+	void FloodFill( int x, int y, Cell value );
+	// Copy out, or write, a block with top-left cell (x, y) a row at a time,
+	// wrapping or clipping like Set
+	void CopyBlock( int x, int y, int width, int height, Pattern& out );
+	void PasteBlock( int x, int y, const Pattern& pattern );
 	void Resize( int width, int height );
+	// Replace the whole grid with cells, width x height, row by row
+	void Load( int width, int height, const std::vector<Cell>& cells );
+	// Fork the current cells, generation and seed, and go back to them later.
+	// Both share bands rather than copying cells.
+	GridCheckpoint Checkpoint( );
+	void Restore( const GridCheckpoint& checkpoint );
+	Rules GetRules( );
+	void SetRules( const Rules& rules );
+	// Cells of row y, Width long. Valid until the grid next changes.
+	const Cell* Row( int y );
+	// Cell ages: while tracked, the tick counts the generations each cell has
+	// been alive in the same pass, saturating at 255; dead cells are 0. Ages
+	// restart whenever the whole grid is replaced, and cells set by edits count
+	// from their next tick. A row whose ages change is stamped like a changed row.
+	void TrackAges( bool enabled );
+	bool TracksAges( );
+	const uint8_t* AgeRow( int y );
+	// Activity heatmap: while tracked, the tick decays each cell's heat by
+	// 1/2^decayShift and adds heat where the cell changed, a row at a time in
+	// the same pass. Heat restarts when the grid changes size.
+	void TrackHeat( bool enabled );
+	bool TracksHeat( );
+	void SetHeatDecay( int decayShift );
+	const uint8_t* HeatRow( int y );
+	// Change tracking: every row that changes is tagged with the current stamp.
+	// Advance the stamp after copying the grid out, so rows stamped newer than
+	// the copy's stamp are exactly the ones that differ from it.
+	uint64_t GetStamp( );
+	void AdvanceStamp( );
+	uint64_t RowStamp( int y );
+	TickTimeline Timeline;
+	uint64_t Generation = 0;
+	uint32_t Seed = 0;					// Seed of the last Randomize, so a field can be recreated
 private:
-	std::vector<Cell> Front;
-	std::vector<Cell> Back;
+	void TickBands( int startBand, int endBand );
+	// Give every band of Back a buffer of its own before a tick, and share the
+	// bands a tick left unchanged with Front after it
+	void PrepareBack( );
+	void FinishTick( );
+	void MarkAll( );
+	// Start every age over, when tracked
+	void ResetAges( );
+	// Cool every cell, when heat is tracked
+	void ResetHeat( );
+	// Fresh bands of zeros for the current size
+	void AllocateBands( );
+	int BandCount( );
+	int BandHeight( int band );
+	// A buffer for band, reused from spares when one is free
+	CellBand NewBand( int band );
+	// Copy band of Front if anything else shares it, keeping its cells if asked
+	void MakeWritable( int band, bool keepCells );
+	// Row y of Front, copied first if shared
+	Cell* WritableRow( int y );
+	std::vector<CellBand> Front;
+	std::vector<CellBand> Back;
+	std::vector<CellBand> spares;
+	std::vector<char> bandChanged;		// Per band, set by the tick that computes it
+	std::vector<uint64_t> RowStamps;
+	uint64_t Stamp = 1;
+	bool tracksAges = false;
+	std::vector<uint8_t> Ages;			// Width x Height, row by row, while tracked
+	bool tracksHeat = false;
+	int heatDecay = 4;
+	std::vector<uint8_t> Heat;			// Likewise
 	inline bool InGrid( int x, int y );
-	int Convolute( int x, int y );
+	// Live neighbors of cell x of the middle row; rows outside the grid are null
+	int Convolute( int x, const Cell* const rows[3] );
 	int GetIdx( int x, int y );
 	int GetX( int i );
 	int GetY( int i );
-	Cell GetBack( int x, int y );
-	void SetBack( int x, int y, Cell value );
 	int Width;
 	int Height;
 };
\ No newline at end of file
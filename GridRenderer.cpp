@@ -0,0 +1,229 @@
+// GridRenderer.cpp
+
+#include "GridRenderer.h"
+
+#include "Profiler.h"
+#include "Simulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// Largest pre-scaled texture edge; beyond this the GPU does the stretch
+static const int MaxPrescaledSize = 8192;
+
+// Pixels to expand before the rows are split across threads
+static const size_t ThreadedExpandPixels = 1 << 18;
+
+GridRenderer::~GridRenderer( ) {
+	// The GL context may already be gone if the window closed first
+	if ( texture.id != 0 && IsWindowReady( ) )
+		UnloadTexture( texture );
+}
+
+// Texture rows never uploaded, or whose contents are stale whatever their stamp
+static const uint64_t NotUploaded = UINT64_MAX;
+
+void GridRenderer::Update( const GridSnapshot& snapshot, Color alive, Color dead, Color old, int prescale, int zoomOut, Rectangle cells ) {
+	if ( snapshot.Width <= 0 || snapshot.Height <= 0 || cells.width <= 0 || cells.height <= 0 )
+		return;
+	uploadedBytes = 0;
+	int sourceWidth = snapshot.Width;
+	int sourceHeight = snapshot.Height;
+	if ( zoomOut > 0 ) {
+		pyramid.Update( snapshot, zoomOut );
+		sourceWidth = pyramid.LevelWidth( zoomOut );
+		sourceHeight = pyramid.LevelHeight( zoomOut );
+		prescale = 1;
+	}
+	// Visible source columns and rows. A view wider or taller than the source
+	// needs only one copy of it; the texture repeats to tile the rest.
+	const int scale = 1 << zoomOut;
+	const int x0 = (int)std::floor( cells.x / scale );
+	const int y0 = (int)std::floor( cells.y / scale );
+	const int visibleColumns = std::min( (int)std::ceil( ( cells.x + cells.width ) / scale ) - x0, sourceWidth );
+	const int visibleRows = std::min( (int)std::ceil( ( cells.y + cells.height ) / scale ) - y0, sourceHeight );
+	if ( prescale < 1 || visibleColumns * prescale > MaxPrescaledSize || visibleRows * prescale > MaxPrescaledSize )
+		prescale = 1;
+	if ( level != zoomOut || textureScale != prescale )
+		rowStamps.assign( rowStamps.size( ), NotUploaded );
+	level = zoomOut;
+
+	// The texture holds the visible window rather than the world. It only grows,
+	// so zooming and resizing the window rarely reallocate it, but never past
+	// one copy of the source, so each texture row can stand for the source rows
+	// that land on it modulo its height.
+	int columns = visibleColumns;
+	int rows = visibleRows;
+	if ( texture.id != 0 && textureScale == prescale ) {
+		columns = std::min( std::max( columns, texture.width / prescale ), sourceWidth );
+		rows = std::min( std::max( rows, texture.height / prescale ), sourceHeight );
+	}
+	textureScale = prescale;
+	if ( texture.id == 0 || texture.width != columns * prescale || texture.height != rows * prescale ) {
+		if ( texture.id != 0 )
+			UnloadTexture( texture );
+		Image image = GenImageColor( columns * prescale, rows * prescale, dead );
+		texture = LoadTextureFromImage( image );
+		UnloadImage( image );
+		// Nearest filtering keeps cells sharp; repeat wrapping lets the world
+		// tile without drawing it more than once
+		SetTextureFilter( texture, TEXTURE_FILTER_POINT );
+		SetTextureWrap( texture, TEXTURE_WRAP_REPEAT );
+		rowKeys.assign( rows, 0 );
+		rowStamps.assign( rows, NotUploaded );
+	}
+	// Texture column 0 is source column originX. Panning moves it and every row
+	// goes stale, except when whole rows are shown, which tile from anywhere.
+	if ( !( visibleColumns == sourceWidth && shownColumns == sourceWidth ) && ( x0 != originX || visibleColumns != shownColumns ) ) {
+		originX = x0;
+		shownColumns = visibleColumns;
+		rowStamps.assign( rows, NotUploaded );
+	}
+	source = { ( cells.x / scale - originX ) * prescale, cells.y / scale * prescale, cells.width / scale * prescale, cells.height / scale * prescale };
+
+	// Cells map straight to the two colors; densities to a 256-step gradient
+	Palette newPalette;
+	newPalette.Size = zoomOut > 0 ? 256 : 2;
+	for ( int i = 0; i < newPalette.Size; i++ ) {
+		float t = (float)i / ( newPalette.Size - 1 );
+		newPalette.Colors[i] = PackColor(
+			(unsigned char)( dead.r + ( alive.r - dead.r ) * t ),
+			(unsigned char)( dead.g + ( alive.g - dead.g ) * t ),
+			(unsigned char)( dead.b + ( alive.b - dead.b ) * t ),
+			(unsigned char)( dead.a + ( alive.a - dead.a ) * t ) );
+	}
+	ages = zoomOut == 0 && !snapshot.Ages.empty( );
+	if ( ages ) {
+		// Ages shade on a log scale, so the first few generations, where chaos
+		// churns, already stand apart from what has settled
+		newPalette.Size = 256;
+		for ( int i = 1; i < newPalette.Size; i++ ) {
+			float t = std::log( (float)i ) / std::log( 255.0f );
+			newPalette.Colors[i] = PackColor(
+				(unsigned char)( alive.r + ( old.r - alive.r ) * t ),
+				(unsigned char)( alive.g + ( old.g - alive.g ) * t ),
+				(unsigned char)( alive.b + ( old.b - alive.b ) * t ),
+				(unsigned char)( alive.a + ( old.a - alive.a ) * t ) );
+		}
+	}
+	if ( newPalette.Size != palette.Size || !std::equal( newPalette.Colors, newPalette.Colors + newPalette.Size, palette.Colors ) ) {
+		palette = newPalette;
+		rowStamps.assign( rows, NotUploaded );
+	}
+
+	// A texture row holds a source row when it was uploaded for that row (by its
+	// visible position unless the texture spans the whole source) and is as new
+	auto key = [&]( int y ) { return rows == sourceHeight ? MOD_POSITIVE( y, sourceHeight ) : y; };
+	auto dirty = [&]( int y ) {
+		const int slot = MOD_POSITIVE( y, rows );
+		return rowStamps[slot] == NotUploaded || rowKeys[slot] != key( y )
+			|| SourceRowStamp( snapshot, MOD_POSITIVE( y, sourceHeight ) ) > rowStamps[slot];
+	};
+	int dirtyRows = 0;
+	for ( int y = y0; y < y0 + visibleRows; y++ )
+		dirtyRows += dirty( y );
+	if ( dirtyRows == 0 ) {
+		averageUploadedBytes += ( uploadedBytes - averageUploadedBytes ) * 0.05;
+		return;
+	}
+
+	PROFILE_ZONE( "GridRenderer::Update" );
+	// Mostly dirty: send the visible rows whole rather than as many small runs.
+	// Runs also split where they wrap around the bottom of the texture.
+	const bool whole = dirtyRows > FullUploadThreshold * visibleRows;
+	std::vector<std::pair<int, int>> runs;
+	for ( int y = y0; y < y0 + visibleRows; ) {
+		if ( !whole && !dirty( y ) ) {
+			y++;
+			continue;
+		}
+		int start = y++;
+		while ( y < y0 + visibleRows && MOD_POSITIVE( y, rows ) != 0 && ( whole || dirty( y ) ) )
+			y++;
+		runs.push_back( { start, y } );
+	}
+
+	// Expand the runs' rows into a staging buffer laid out like the visible window
+	const size_t rowPixels = (size_t)visibleColumns * prescale * prescale;
+	pixels.resize( rowPixels * visibleRows );
+	std::vector<int> expanded;
+	for ( auto& run : runs )
+		for ( int y = run.first; y < run.second; y++ )
+			expanded.push_back( y );
+	auto expand = [&]( size_t first, size_t last ) {
+		std::vector<uint8_t> densities( level > 0 ? sourceWidth : 0 );
+		std::vector<uint32_t> row( prescale > 1 ? visibleColumns : 0 );
+		for ( size_t i = first; i < last; i++ )
+			ExpandRow( snapshot, MOD_POSITIVE( expanded[i], sourceHeight ), sourceWidth, visibleColumns,
+				densities.data( ), row.data( ), pixels.data( ) + ( expanded[i] - y0 ) * rowPixels );
+	};
+	int numThreads = (int)std::min<size_t>( std::thread::hardware_concurrency( ), expanded.size( ) * rowPixels / ThreadedExpandPixels );
+	numThreads = std::min<int>( numThreads, (int)expanded.size( ) );
+	if ( numThreads <= 1 ) {
+		expand( 0, expanded.size( ) );
+	} else {
+		std::vector<std::thread> threads( numThreads );
+		for ( int i = 0; i < numThreads; i++ )
+			threads[i] = std::thread( expand, expanded.size( ) * i / numThreads, expanded.size( ) * ( i + 1 ) / numThreads );
+		for ( auto& thread : threads ) thread.join( );
+	}
+
+	for ( auto& run : runs ) {
+		for ( int y = run.first; y < run.second; y++ ) {
+			const int slot = MOD_POSITIVE( y, rows );
+			rowKeys[slot] = key( y );
+			rowStamps[slot] = SourceRowStamp( snapshot, MOD_POSITIVE( y, sourceHeight ) );
+		}
+		const int slot = MOD_POSITIVE( run.first, rows );
+		Rectangle rect = { 0, (float)slot * prescale, (float)visibleColumns * prescale, (float)( run.second - run.first ) * prescale };
+		UpdateTextureRec( texture, rect, pixels.data( ) + ( run.first - y0 ) * rowPixels );
+		uploadedBytes += ( run.second - run.first ) * rowPixels * sizeof( uint32_t );
+	}
+	averageUploadedBytes += ( uploadedBytes - averageUploadedBytes ) * 0.05;
+}
+
+uint64_t GridRenderer::SourceRowStamp( const GridSnapshot& snapshot, int y ) {
+	return level > 0 ? pyramid.RowStamp( level, y ) : snapshot.RowStamps[y];
+}
+
+void GridRenderer::ExpandRow( const GridSnapshot& snapshot, int y, int sourceWidth, int count, uint8_t* densities, uint32_t* row, uint32_t* out ) {
+	const Cell* cells;
+	if ( level == 0 ) {
+		cells = ( ages ? snapshot.Ages.data( ) : snapshot.Cells.data( ) ) + (size_t)y * snapshot.Width;
+	} else {
+		pyramid.Densities( level, y, densities );
+		cells = densities;
+	}
+	// In pieces that each stay within one copy of the source row
+	uint32_t* dest = textureScale > 1 ? row : out;
+	for ( int x = 0; x < count; ) {
+		int column = MOD_POSITIVE( originX + x, sourceWidth );
+		int length = std::min( count - x, sourceWidth - column );
+		ExpandCells( cells + column, length, palette, dest + x );
+		x += length;
+	}
+	if ( textureScale == 1 )
+		return;
+	const size_t outWidth = (size_t)count * textureScale;
+	for ( int x = 0; x < count; x++ )
+		std::fill_n( out + (size_t)x * textureScale, textureScale, row[x] );
+	for ( int copy = 1; copy < textureScale; copy++ )
+		memcpy( out + copy * outWidth, out, outWidth * sizeof( uint32_t ) );
+}
+
+size_t GridRenderer::GetUploadedBytes( ) {
+	return uploadedBytes;
+}
+
+double GridRenderer::GetAverageUploadedBytes( ) {
+	return averageUploadedBytes;
+}
+
+void GridRenderer::Draw( Rectangle screen ) {
+	if ( texture.id == 0 )
+		return;
+	PROFILE_ZONE( "GridRenderer::Draw" );
+	DrawTexturePro( texture, source, screen, { 0, 0 }, 0, WHITE );
+}
\ No newline at end of file
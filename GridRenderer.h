@@ -0,0 +1,68 @@
+// GridRenderer.h
+
+#pragma once
+
+#include <raylib.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "DensityPyramid.h"
+#include "PixelExpand.h"
+
+struct GridSnapshot;
+
+// Draws a snapshot as one streamed texture: the visible cells are expanded to
+// pixels once per published snapshot and drawn as a single scaled quad. The
+// texture covers the visible window rather than the world, with source rows
+// wrapping around its height, so only visible rows that changed since they were
+// last uploaded are sent, as sub-rectangles of just the visible columns; rows
+// out of view wait until they scroll in. With pre-scaling the texture is
+// expanded at a whole-pixel scale on the CPU and only stretched the remainder.
+// Zoomed out, the texture is a density-shaded level of a DensityPyramid instead.
+class GridRenderer {
+public:
+	GridRenderer( ) = default;
+	~GridRenderer( );
+	GridRenderer( const GridRenderer& ) = delete;
+	GridRenderer& operator=( const GridRenderer& ) = delete;
+
+	// Bring the texture up to date with the given rectangle of the snapshot's
+	// cells and the colors, expanding each cell to a prescale x prescale square,
+	// or with one pixel per 2^zoomOut square block of cells when zoomOut > 0.
+	// Cells outside the grid wrap around. When the snapshot has ages, live cells
+	// shade from alive to old as they age, unless zoomed out.
+	void Update( const GridSnapshot& snapshot, Color alive, Color dead, Color old, int prescale, int zoomOut, Rectangle cells );
+
+	// Bytes sent to the texture by the last Update, and a smoothed average
+	size_t GetUploadedBytes( );
+	double GetAverageUploadedBytes( );
+
+	// Fraction of dirty rows above which the whole texture is uploaded at once
+	float FullUploadThreshold = 0.5f;
+
+	// Draw the cells last passed to Update into the screen rectangle
+	void Draw( Rectangle screen );
+
+private:
+	// Write count columns of source row y, from originX on, to out as textureScale
+	// rows of pixels. densities holds a source row; row holds count pixels.
+	void ExpandRow( const GridSnapshot& snapshot, int y, int sourceWidth, int count, uint8_t* densities, uint32_t* row, uint32_t* out );
+	uint64_t SourceRowStamp( const GridSnapshot& snapshot, int y );
+
+	DensityPyramid pyramid;
+	std::vector<uint8_t> densities;
+	int level = 0;
+	Texture2D texture{};
+	std::vector<uint32_t> pixels;
+	Palette palette;
+	bool ages = false;						// Whether the texture shows the snapshot's ages
+	std::vector<int> rowKeys;				// Visible source row each texture row was last uploaded for
+	std::vector<uint64_t> rowStamps;		// Source row stamp each texture row was last uploaded at
+	int originX = 0;						// Source column of texture column 0
+	int shownColumns = 0;					// Source columns the texture rows hold
+	Rectangle source{};						// Texels of the visible cells
+	int textureScale = 1;
+	size_t uploadedBytes = 0;
+	double averageUploadedBytes = 0;
+};
\ No newline at end of file
@@ -5,8 +5,13 @@
 #include "Simulation.h"
 
 #include <imgui.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include "Grid.h"
+#include "Profiler.h"
 
 // Convert from Raylib to ImGui color format
 ImVec4 RlToImGuiColor( Color col ) {
@@ -28,9 +33,18 @@ Color ImGuiToRlColor( ImVec4 col ) {
 	};
 }
 
+// Lane colors indexed by LaneState
+static const ImU32 LaneColors[] = {
+	IM_COL32( 80, 200, 120, 255 ),	// Busy
+	IM_COL32( 200, 80, 80, 255 ),	// Idle at barrier
+	IM_COL32( 230, 190, 60, 255 ),	// Stealing
+};
+
 GuiManager::GuiManager( Simulation& simulation ) {
 	sim = &simulation;
-	grid = &sim->GetGrid( );
+	rules = &sim->GetRules( );
+	worldSize[0] = sim->GetSnapshot( ).Width;
+	worldSize[1] = sim->GetSnapshot( ).Height;
 }
 
 void GuiManager::Draw( ) {
@@ -38,39 +52,92 @@ void GuiManager::Draw( ) {
 	ImGui::Begin( "Life23", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoResize );
 
 	ImGui::LabelText( "FPS", std::to_string( GetFPS( ) ).c_str( ) );
-	// TODO: Fix this
-//	ImGui::LabelText( "TPS", std::to_string( sim->ActualTickRate ).c_str( ) );
-	ImGui::InputInt( "Ticks per second", &sim->TicksPerSecond, 1, 10 );
-	int newScale = sim->Scale;
-	ImGui::InputInt( "Scale", &newScale, 1, 5 );
-	if ( newScale < 1 )
-		newScale = 1;
-	if ( newScale > std::min( sim->Width, sim->Height ) )
-		newScale = std::min( sim->Width, sim->Height );
-	if ( sim->Scale != newScale ) {
-		sim->Scale = newScale;
-		grid->Resize( sim->Width / sim->Scale, sim->Height / sim->Scale );
+	ImGui::LabelText( "TPS", std::to_string( sim->ActualTickRate ).c_str( ) );
+	ImGui::Checkbox( "Unlimited ticks", &sim->UnlimitedTicks );
+	if ( sim->UnlimitedTicks ) {
+		ImGui::SliderFloat( "Frame share", &sim->UnlimitedShare, 0.1f, 1.0f, "%.2f" );
+	} else {
+		ImGui::InputInt( "Ticks per second", &sim->TicksPerSecond, 1, 10 );
+		if ( sim->TicksPerSecond < 1 )
+			sim->TicksPerSecond = 1;
+	}
+	// Zoom is continuous; below one pixel per cell a density pyramid level is drawn
+	if ( ImGui::SliderFloat( "Zoom", &sim->Camera.zoom, Simulation::MinZoom, Simulation::MaxZoom, "%.3f px/cell", ImGuiSliderFlags_Logarithmic ) )
+		sim->ZoomAt( { sim->Width / 2.0f, sim->Height / 2.0f }, 1 );
+	if ( sim->ZoomLevel( ) > 0 )
+		ImGui::Text( "%d x %d cells per pixel", 1 << sim->ZoomLevel( ), 1 << sim->ZoomLevel( ) );
+	if ( ImGui::Button( "Fit world in view" ) )
+		sim->FitCamera( );
+	ImGui::InputInt2( "World size", worldSize );
+	worldSize[0] = std::max( worldSize[0], 1 );
+	worldSize[1] = std::max( worldSize[1], 1 );
+	const bool fits = (int64_t)worldSize[0] * worldSize[1] <= Simulation::MaxWorldCells;
+	if ( ImGui::Button( "Window size" ) ) {
+		worldSize[0] = std::max( (int)( sim->Width / sim->Camera.zoom ), 1 );
+		worldSize[1] = std::max( (int)( sim->Height / sim->Camera.zoom ), 1 );
+	}
+	ImGui::SameLine( );
+	if ( fits && ImGui::Button( "Resize world" ) )
+		sim->ResizeGrid( worldSize[0], worldSize[1] );
+	if ( !fits )
+		ImGui::TextDisabled( "Larger than %lld cells", (long long)Simulation::MaxWorldCells );
+	// Engines register themselves; the new one takes the world over between generations
+	if ( ImGui::BeginCombo( "Engine", sim->EngineName.c_str( ) ) ) {
+		for ( const EngineInfo& info : RegisteredEngines( ) ) {
+			const bool selected = sim->EngineName == info.Name;
+			if ( ImGui::Selectable( info.Name, selected ) )
+				sim->EngineName = info.Name;
+			if ( ImGui::IsItemHovered( ) )
+				ImGui::SetTooltip( "%s", info.Description );
+			if ( selected )
+				ImGui::SetItemDefaultFocus( );
+		}
+		ImGui::EndCombo( );
+	}
+	ImGui::Checkbox( "Population and hash", &sim->EngineStats );
+	if ( sim->EngineStats ) {
+		const GridSnapshot& snapshot = sim->GetSnapshot( );
+		ImGui::Text( "%llu live, hash %016llx", (unsigned long long)snapshot.Population, (unsigned long long)snapshot.Hash );
 	}
 	ImGui::Checkbox( "Enable multithreading", &sim->UseMultithreading );
+	ImGui::SliderInt( "Look ahead", &sim->LookAhead, 0, 64, "%d generations while paused" );
+	// Only the view's light cone is run, so far generations of a small view stay cheap
+	ImGui::SliderInt( "View ahead", &sim->ViewAhead, 0, 4096, sim->ViewAhead > 0 ? "%d generations" : "Off", ImGuiSliderFlags_Logarithmic );
+	if ( sim->ViewAhead > 0 ) {
+		if ( sim->AheadGeneration( ) > 0 )
+			ImGui::TextDisabled( "Showing generation %llu%s", (unsigned long long)sim->AheadGeneration( ), sim->ComputingAhead( ) ? ", updating" : "" );
+		else
+			ImGui::TextDisabled( "Working out the view..." );
+	}
 	ImGui::Checkbox( "Enable grid", &sim->EnableGrid );
-	if ( ImGui::Button( "Reset all settings" ) )
+	ImGui::Checkbox( "Pre-scale on CPU", &sim->PrescaleTexture );
+	{
+		GridRenderer& renderer = sim->GetRenderer( );
+		ImGui::Text( "Texture upload: %.1f KB/frame (avg %.1f KB)", renderer.GetUploadedBytes( ) / 1024.0, renderer.GetAverageUploadedBytes( ) / 1024.0 );
+		ImGui::SliderFloat( "Full upload above", &renderer.FullUploadThreshold, 0.0f, 1.0f, "%.2f dirty" );
+	}
+	if ( ImGui::Button( "Reset all settings" ) ) {
 		sim->ResetToDefaults( );
+		// Defaults size the world to the window at the default zoom
+		worldSize[0] = (int)( sim->Width / sim->Camera.zoom );
+		worldSize[1] = (int)( sim->Height / sim->Camera.zoom );
+	}
 	ImGui::Separator( );
 
 	{
 		ImVec2 size = { ImGui::CalcTextSize( "Always off" ).x + style.ItemInnerSpacing.x * 2, 0 };
-		switch ( grid->EdgeBehavior ) {
+		switch ( rules->EdgeBehavior ) {
 		case AlwaysOff:
 			if ( ImGui::Button( "Always off", size ) )
-				grid->EdgeBehavior = AlwaysOn;
+				rules->EdgeBehavior = AlwaysOn;
 			break;
 		case AlwaysOn:
 			if ( ImGui::Button( "Always on", size ) )
-				grid->EdgeBehavior = Wrap;
+				rules->EdgeBehavior = Wrap;
 			break;
 		case Wrap:
 			if ( ImGui::Button( "Wrap", size ) )
-				grid->EdgeBehavior = AlwaysOff;
+				rules->EdgeBehavior = AlwaysOff;
 			break;
 		default:
 			break;
@@ -84,31 +151,244 @@ void GuiManager::Draw( ) {
 		if ( sim->Paused ) {
 			ImGui::SameLine( );
 			if ( ImGui::Button( "Tick" ) )
-				grid->Tick( );
+				sim->Step( );
+			if ( sim->LookAhead > 0 ) {
+				ImGui::SameLine( );
+				ImGui::TextDisabled( "%d ready", sim->GetSpeculation( ).Ready( ) );
+			}
+		}
+		if ( ImGui::Button( "Clear" ) ) {
+			sim->MarkUndo( );
+			sim->Post( EditOp::Clear( ) );
 		}
-		if ( ImGui::Button( "Clear" ) )
-			grid->Clear( );
 	}
 
 	ImGui::Separator( );
 
+	if ( ImGui::CollapsingHeader( "Editing" ) ) {
+		const char* toolNames[] = { "Brush", "Bucket", "Select" };
+		for ( int tool = ToolBrush; tool <= ToolSelect; tool++ ) {
+			if ( tool != ToolBrush )
+				ImGui::SameLine( );
+			if ( ImGui::RadioButton( toolNames[tool], sim->Tool == tool ) )
+				sim->Tool = (EditTool)tool;
+		}
+		UndoStack& undo = sim->GetUndo( );
+		const size_t undoCount = undo.UndoCount( );
+		const size_t redoCount = undo.RedoCount( );
+		char label[32];
+		snprintf( label, sizeof( label ), "Undo (%zu)###Undo", undoCount );
+		ImGui::BeginDisabled( undoCount == 0 );
+		if ( ImGui::Button( label ) )
+			sim->Undo( );
+		ImGui::EndDisabled( );
+		ImGui::SameLine( );
+		snprintf( label, sizeof( label ), "Redo (%zu)###Redo", redoCount );
+		ImGui::BeginDisabled( redoCount == 0 );
+		if ( ImGui::Button( label ) )
+			sim->Redo( );
+		ImGui::EndDisabled( );
+		ImGui::SameLine( );
+		ImGui::Text( "%.1f MB", undo.MemoryUsed( ) / ( 1024.0 * 1024.0 ) );
+		ImGui::SliderInt( "Undo memory", &sim->UndoMemoryMB, 16, 4096, "%d MB", ImGuiSliderFlags_Logarithmic );
+		const Selection& selected = sim->Selected;
+		if ( selected.Width > 0 && selected.Height > 0 ) {
+			ImGui::Text( "Selection %d x %d at (%d, %d)", selected.Width, selected.Height, selected.X, selected.Y );
+			if ( ImGui::Button( "Copy" ) )
+				sim->CopySelection( );
+			ImGui::SameLine( );
+			if ( ImGui::Button( "Cut" ) )
+				sim->CutSelection( );
+			ImGui::SameLine( );
+			if ( ImGui::Button( "Delete" ) )
+				sim->DeleteSelection( );
+			if ( ImGui::Button( "Rotate" ) )
+				sim->RotateSelection( );
+			ImGui::SameLine( );
+			if ( ImGui::Button( "Flip horizontal" ) )
+				sim->FlipSelection( true );
+			ImGui::SameLine( );
+			if ( ImGui::Button( "Flip vertical" ) )
+				sim->FlipSelection( false );
+		}
+		if ( sim->Clipboard.Width > 0 ) {
+			ImGui::Text( "Clipboard %d x %d", sim->Clipboard.Width, sim->Clipboard.Height );
+			ImGui::SameLine( );
+			// Without a selection to paste over, paste at the top-left of the view
+			if ( ImGui::Button( "Paste" ) ) {
+				if ( selected.Width > 0 )
+					sim->Paste( selected.X, selected.Y );
+				else
+					sim->Paste( (int)sim->Camera.target.x, (int)sim->Camera.target.y );
+			}
+		}
+		ImGui::Separator( );
+	}
+
+	if ( ImGui::CollapsingHeader( "Patterns" ) ) {
+		ImGui::InputText( "Pattern file", patternPath, sizeof( patternPath ) );
+		// Files ending in .mc are macrocells, anything else RLE
+		const size_t pathLength = strlen( patternPath );
+		const bool macrocell = pathLength >= 3 && strcmp( patternPath + pathLength - 3, ".mc" ) == 0;
+		if ( !macrocell )
+			ImGui::Checkbox( "Resize world to pattern", &patternResizesWorld );
+		// RLE loads over the selection if there is one, otherwise at the top-left of the view
+		if ( ImGui::Button( "Load" ) ) {
+			const Selection& selected = sim->Selected;
+			int x = selected.Width > 0 ? selected.X : (int)sim->Camera.target.x;
+			int y = selected.Width > 0 ? selected.Y : (int)sim->Camera.target.y;
+			std::string error;
+			bool loaded = macrocell
+				? sim->LoadMacrocell( patternPath, error )
+				: sim->LoadPattern( patternPath, x, y, patternResizesWorld, error );
+			patternStatus = loaded ? "Loaded " + std::string( patternPath ) : error;
+		}
+		ImGui::SameLine( );
+		if ( ImGui::Button( sim->Selected.Width > 0 ? "Save selection" : "Save world" ) ) {
+			std::string error;
+			bool saved = macrocell ? sim->SaveMacrocell( patternPath, error ) : sim->SavePattern( patternPath, error );
+			patternStatus = saved ? "Wrote " + std::string( patternPath ) : error;
+		}
+		if ( !patternStatus.empty( ) )
+			ImGui::Text( "%s", patternStatus.c_str( ) );
+		// A loaded macrocell can be far bigger than the world; pick which part to show
+		Quadtree& tree = sim->Macrocell;
+		if ( tree.Root != 0 ) {
+			ImGui::Text( "Macrocell 2^%d square, %zu nodes, %llu live cells", tree.RootLevel, tree.NodeCount( ),
+				(unsigned long long)tree.Population( tree.Root ) );
+			int64_t origin[2] = { sim->MacrocellX, sim->MacrocellY };
+			if ( ImGui::InputScalarN( "Window origin", ImGuiDataType_S64, origin, 2 ) ) {
+				sim->MacrocellX = origin[0];
+				sim->MacrocellY = origin[1];
+			}
+			if ( ImGui::Button( "Show window" ) )
+				sim->MaterializeMacrocell( );
+		}
+		ImGui::Separator( );
+	}
+
+	if ( ImGui::CollapsingHeader( "World files" ) ) {
+		ImGui::InputText( "Snapshot file", worldPath, sizeof( worldPath ) );
+		ImGui::Checkbox( "Bit-packed", &worldBitPacked );
+		if ( ImGui::Button( "Save world##snapshot" ) ) {
+			std::string error;
+			if ( sim->SaveWorld( worldPath, worldBitPacked, error ) )
+				worldStatus = "Wrote " + std::string( worldPath );
+			else
+				worldStatus = error;
+		}
+		ImGui::SameLine( );
+		if ( ImGui::Button( "Load world" ) ) {
+			std::string error;
+			if ( sim->LoadWorld( worldPath, error ) )
+				worldStatus = "Loaded " + std::string( worldPath );
+			else
+				worldStatus = error;
+		}
+		if ( !worldStatus.empty( ) )
+			ImGui::Text( "%s", worldStatus.c_str( ) );
+		ImGui::Separator( );
+	}
+
+	if ( ImGui::CollapsingHeader( "Export" ) ) {
+		FrameExporter& exporter = sim->GetExporter( );
+		const bool exporting = exporter.Active( );
+		ImGui::BeginDisabled( exporting );
+		// .y4m and .rgb are single video files, anything else a numbered PNG per frame
+		ImGui::InputText( "Export file", exportPath, sizeof( exportPath ) );
+		ImGui::SliderInt( "Every", &exportSettings.Every, 1, 1000, "%d generations", ImGuiSliderFlags_Logarithmic );
+		ImGui::SliderInt( "Scale", &exportSettings.Scale, 1, 16, "%d px per cell" );
+		if ( ExportFormatFor( exportPath ) == ExportY4m )
+			ImGui::SliderInt( "Frame rate", &exportSettings.FrameRate, 1, 120 );
+		ImGui::EndDisabled( );
+		if ( !exporting && ImGui::Button( "Start export" ) ) {
+			std::string error;
+			exportSettings.Path = exportPath;
+			if ( sim->StartExport( exportSettings, error ) )
+				exportStatus.clear( );
+			else
+				exportStatus = error;
+		}
+		if ( exporting ) {
+			if ( ImGui::Button( "Stop export" ) ) {
+				std::string error;
+				if ( sim->StopExport( error ) )
+					exportStatus = "Wrote " + std::to_string( exporter.FramesWritten( ) ) + " frames";
+				else
+					exportStatus = error;
+			}
+			ImGui::Text( "%llu frames written, %d queued, %.1f s waiting for the encoders",
+				(unsigned long long)exporter.FramesWritten( ), exporter.FramesQueued( ), exporter.StallSeconds( ) );
+			const std::string error = exporter.GetError( );
+			if ( !error.empty( ) )
+				ImGui::Text( "Stopped: %s", error.c_str( ) );
+		}
+		if ( !exportStatus.empty( ) )
+			ImGui::Text( "%s", exportStatus.c_str( ) );
+		ImGui::Separator( );
+	}
+
+	if ( ImGui::CollapsingHeader( "History" ) ) {
+		ImGui::Checkbox( "Record history", &sim->RecordHistory );
+		ImGui::SliderInt( "Keyframe every", &sim->HistoryKeyframeInterval, 1, 1024, "%d generations", ImGuiSliderFlags_Logarithmic );
+		ImGui::SliderInt( "Memory budget", &sim->HistoryMemoryMB, 16, 4096, "%d MB", ImGuiSliderFlags_Logarithmic );
+		History& history = sim->GetHistory( );
+		const uint64_t oldest = history.Oldest( );
+		const uint64_t newest = history.Newest( );
+		if ( oldest > newest ) {
+			ImGui::TextDisabled( "Nothing recorded yet" );
+		} else {
+			ImGui::Text( "Generations %llu to %llu, %.1f MB", (unsigned long long)oldest, (unsigned long long)newest,
+				history.MemoryUsed( ) / ( 1024.0 * 1024.0 ) );
+			// Scrubbing pauses, or the simulation would carry straight on from where it lands
+			const uint64_t current = sim->GetSnapshot( ).Generation;
+			int position = (int)( std::min( std::max( current, oldest ), newest ) - oldest );
+			char shown[32];
+			snprintf( shown, sizeof( shown ), "Generation %llu", (unsigned long long)current );
+			if ( ImGui::SliderInt( "Rewind", &position, 0, (int)std::min<uint64_t>( newest - oldest, INT_MAX ), shown ) ) {
+				sim->Paused = true;
+				sim->Post( EditOp::Seek( oldest + position ) );
+			}
+			if ( ImGui::Button( "Step back" ) && current > oldest ) {
+				sim->Paused = true;
+				sim->Post( EditOp::Seek( current - 1 ) );
+			}
+		}
+		ImGui::Separator( );
+	}
+
 	if ( ImGui::CollapsingHeader( "Randomizer" ) ) {
 		bool random = ImGui::Button( "Randomize checked" );
 
 		ImGui::Checkbox( "##Randomize field", &sim->RandomField );
 		ImGui::SameLine( );
 		if ( ImGui::Button( "Randomize field" ) || ( random && sim->RandomField ) ) {
-			grid->Randomize( sim->PercentFilled );
-			for ( int i = 0; i < sim->PreemptiveIterations; i++ ) {
-				grid->Tick( );
-			}
+			sim->MarkUndo( );
+			sim->Post( EditOp::Randomize( sim->PercentFilled, sim->PreemptiveIterations ) );
+		}
+		// The same seed and percent filled give the same field again
+		ImGui::Text( "Seed of this field: %u", sim->GetSnapshot( ).Seed );
+		ImGui::InputScalar( "Seed", ImGuiDataType_U32, &fieldSeed );
+		if ( ImGui::Button( "Recreate field from seed" ) ) {
+			sim->MarkUndo( );
+			sim->Post( EditOp::Randomize( sim->PercentFilled, sim->PreemptiveIterations, fieldSeed ) );
+		}
+		// A field with preemptive iterations is shown once its warm-up is done
+		WarmUp& warmUp = sim->GetWarmUp( );
+		if ( warmUp.Running( ) ) {
+			const int total = std::max( warmUp.Total( ), 1 );
+			char progress[64];
+			snprintf( progress, sizeof( progress ), "Warming up %d / %d", warmUp.Done( ), total );
+			ImGui::ProgressBar( (float)warmUp.Done( ) / total, ImVec2( -1.0f, 0.0f ), progress );
+			if ( ImGui::Button( "Cancel warm-up" ) )
+				warmUp.Cancel( );
 		}
 
 		ImGui::Checkbox( "##Randomize edge behavior", &sim->RandomEdgeBehavior );
 		ImGui::SameLine( );
 		if ( ImGui::Button( "Randomize edge behavior" ) || ( random && sim->RandomEdgeBehavior ) ) {
 			int edgeRand = rand( ) % 3;
-			grid->EdgeBehavior = edgeRand == 0 ? AlwaysOff : edgeRand == 1 ? AlwaysOn : Wrap;
+			rules->EdgeBehavior = edgeRand == 0 ? AlwaysOff : edgeRand == 1 ? AlwaysOn : Wrap;
 		}
 
 		ImGui::Checkbox( "##Randomize colors", &sim->RandomColors );
@@ -126,7 +406,7 @@ void GuiManager::Draw( ) {
 		ImGui::SameLine( );
 		if ( ImGui::Button( "Randomize neighbors" ) || ( random && sim->RandomNeighbors ) ) {
 			for ( size_t i = 0; i < 8; i++ ) {
-				grid->Neighborhood[i] = rand( ) % 2 == 0;
+				rules->Neighborhood[i] = rand( ) % 2 == 0;
 			}
 		}
 
@@ -134,11 +414,11 @@ void GuiManager::Draw( ) {
 		ImGui::SameLine( );
 		if ( ImGui::Button( "Randomize rules" ) || ( random && sim->RandomRules ) ) {
 			for ( size_t i = 0; i < 9; i++ ) {
-				grid->BirthRule[i] = rand( ) % 2;
-				grid->SurviveRule[i] = rand( ) % 2;
+				rules->BirthRule[i] = rand( ) % 2;
+				rules->SurviveRule[i] = rand( ) % 2;
 			}
 			if ( sim->DisableStrobing )
-				grid->BirthRule[0] = false;
+				rules->BirthRule[0] = false;
 		}
 
 		if ( ImGui::CollapsingHeader( "Advanced" ) ) {
@@ -165,6 +445,35 @@ void GuiManager::Draw( ) {
 		auto newDeadColor = RlToImGuiColor( sim->DeadColor );
 		ImGui::ColorPicker3( "Dead color", (float*)&newDeadColor );
 		sim->DeadColor = ImGuiToRlColor( newDeadColor );
+		// Ages are only counted while this is on
+		ImGui::Checkbox( "Color by age", &sim->ColorByAge );
+		if ( sim->ColorByAge ) {
+			auto newOldColor = RlToImGuiColor( sim->OldColor );
+			ImGui::ColorPicker3( "Old color", (float*)&newOldColor );
+			sim->OldColor = ImGuiToRlColor( newOldColor );
+		}
+		ImGui::Separator( );
+	}
+
+	if ( ImGui::CollapsingHeader( "Heatmap" ) ) {
+		// Heat is only tracked while it is shown
+		ImGui::Checkbox( "Show heatmap", &sim->ShowHeatmap );
+		char decay[48];
+		snprintf( decay, sizeof( decay ), "1/%d of the heat per generation", 1 << sim->HeatDecay );
+		ImGui::SliderInt( "Heat decay", &sim->HeatDecay, 1, 8, decay );
+		auto newHeatColor = RlToImGuiColor( sim->HeatColor );
+		ImGui::ColorPicker3( "Heat color", (float*)&newHeatColor );
+		sim->HeatColor = ImGuiToRlColor( newHeatColor );
+		ImGui::InputText( "Heatmap file", heatmapPath, sizeof( heatmapPath ) );
+		if ( ImGui::Button( "Save heatmap" ) ) {
+			std::string error;
+			if ( sim->SaveHeatmap( heatmapPath, error ) )
+				heatmapStatus = "Wrote " + std::string( heatmapPath );
+			else
+				heatmapStatus = error;
+		}
+		if ( !heatmapStatus.empty( ) )
+			ImGui::Text( "%s", heatmapStatus.c_str( ) );
 		ImGui::Separator( );
 	}
 
@@ -176,7 +485,7 @@ void GuiManager::Draw( ) {
 			if ( i == 4 )
 				ImGui::SetCursorPosX( ImGui::GetCursorPosX( ) + ImGui::GetItemRectSize( ).x + style.CellPadding.x * 2 );
 			std::string id = "##NH" + std::to_string( i );
-			ImGui::Checkbox( id.c_str( ), &grid->Neighborhood[i] );
+			ImGui::Checkbox( id.c_str( ), &rules->Neighborhood[i] );
 		}
 		ImGui::Separator( );
 	}
@@ -184,15 +493,15 @@ void GuiManager::Draw( ) {
 	if ( ImGui::CollapsingHeader( "Rules" ) ) {
 		int neighborhoodSize = 0;
 		for ( size_t i = 0; i < 8; i++ )
-			neighborhoodSize += grid->Neighborhood[i];
+			neighborhoodSize += rules->Neighborhood[i];
 		for ( size_t i = 0; i < 9; i++ ) {
 			if ( i > neighborhoodSize )
 				break;
 			std::string id = std::to_string( i ) + "##BR" + std::to_string( i );
-			ImGui::Checkbox( id.c_str( ), (bool*)&grid->BirthRule[i] );
+			ImGui::Checkbox( id.c_str( ), (bool*)&rules->BirthRule[i] );
 			ImGui::SameLine( );
 			id = "##SR" + std::to_string( i );
-			ImGui::Checkbox( id.c_str( ), (bool*)&grid->SurviveRule[i] );
+			ImGui::Checkbox( id.c_str( ), (bool*)&rules->SurviveRule[i] );
 		}
 		if ( ImGui::Button( "Reverse rule" ) ) {
 			int mx = neighborhoodSize;
@@ -200,16 +509,134 @@ void GuiManager::Draw( ) {
 			int birth[9]{ };
 			int survive[9]{ };
 			for ( size_t i = 0; i < sz; i++ ) {
-				birth[mx - i] = !grid->SurviveRule[i];
-				survive[mx - i] = !grid->BirthRule[i];
+				birth[mx - i] = !rules->SurviveRule[i];
+				survive[mx - i] = !rules->BirthRule[i];
 			}
 			for ( size_t i = 0; i < sz; i++ ) {
-				grid->BirthRule[i] = birth[i];
-				grid->SurviveRule[i] = survive[i];
+				rules->BirthRule[i] = birth[i];
+				rules->SurviveRule[i] = survive[i];
+			}
+		}
+		ImGui::Separator( );
+	}
+
+	if ( ImGui::CollapsingHeader( "Thread timeline" ) ) {
+		DrawTimeline( );
+		ImGui::Separator( );
+	}
+
+	if ( ImGui::CollapsingHeader( "Hardware counters" ) ) {
+		ImGui::Checkbox( "Count every tick", &sim->UsePerfCounters );
+		PerfCounters& counters = sim->GetPerfCounters( );
+		if ( counters.IsOpen( ) && !counters.GetError( ).empty( ) )
+			ImGui::TextDisabled( "%s", counters.GetError( ).c_str( ) );
+		if ( counters.IsOpen( ) && counters.IsAvailable( ) ) {
+			const GridSnapshot& snapshot = sim->GetSnapshot( );
+			const PerfSample* samples[] = { &snapshot.LastTickCounters, &snapshot.TotalCounters };
+			const char* labels[] = { "Last tick", "Since reset" };
+			for ( int i = 0; i < 2; i++ ) {
+				const PerfSample& sample = *samples[i];
+				ImGui::Text( "%s (%llu cells)", labels[i], (unsigned long long)sample.Cells );
+				ImGui::Text( "  IPC %.2f", sample.IPC( ) );
+				ImGui::Text( "  L1 misses/cell %.4f, LLC misses/cell %.4f", sample.PerCell( PerfL1Misses ), sample.PerCell( PerfLLCMisses ) );
+				ImGui::Text( "  Branch misses/cell %.4f", sample.PerCell( PerfBranchMisses ) );
 			}
+			if ( ImGui::Button( "Reset counters" ) )
+				sim->ResetCounters( );
 		}
 		ImGui::Separator( );
 	}
 
+	if ( ImGui::CollapsingHeader( "Profiling" ) ) {
+		bool capturing = Profiler::IsCapturing( );
+		if ( ImGui::Checkbox( "Capture zones", &capturing ) )
+			Profiler::SetCapturing( capturing );
+		ImGui::InputText( "Trace file", tracePath, sizeof( tracePath ) );
+		if ( ImGui::Button( "Export trace" ) )
+			traceStatus = Profiler::ExportChromeTrace( tracePath ) ? "Wrote " + std::string( tracePath ) : "Could not write " + std::string( tracePath );
+		ImGui::SameLine( );
+		if ( ImGui::Button( "Discard" ) )
+			Profiler::Reset( );
+		if ( !traceStatus.empty( ) )
+			ImGui::Text( "%s", traceStatus.c_str( ) );
+		ImGui::Separator( );
+	}
+
 	ImGui::End( );
+}
+
+void GuiManager::DrawTimeline( ) {
+	ImGui::SliderInt( "Ticks shown", &timelineTicks, 1, TickTimeline::Capacity );
+	sim->GetGrid( ).Timeline.Latest( timelineTicks, timelineRecords );
+	if ( timelineRecords.empty( ) ) {
+		ImGui::TextDisabled( "No ticks recorded yet" );
+		return;
+	}
+
+	int lanes = 0;
+	uint64_t total = 0;
+	for ( const TickRecord& record : timelineRecords ) {
+		lanes = std::max( lanes, record.lanes );
+		total += std::max<uint64_t>( record.end - record.start, 1 );
+	}
+
+	// Ticks are laid end to end with the time between them cut out, so the
+	// bars stay readable no matter how long the frames in between took.
+	const ImGuiStyle& style = ImGui::GetStyle( );
+	const float labelWidth = ImGui::CalcTextSize( "Worker 000" ).x + style.ItemInnerSpacing.x;
+	const float width = 420.0f;
+	const float laneHeight = ImGui::GetTextLineHeight( );
+	const float laneStride = laneHeight + 2.0f;
+	const double scale = width / (double)total;
+	ImDrawList* drawList = ImGui::GetWindowDrawList( );
+	ImVec2 origin = ImGui::GetCursorScreenPos( );
+
+	for ( int lane = 0; lane < lanes; lane++ ) {
+		std::string label = lane == 0 ? "Sim" : "Worker " + std::to_string( lane - 1 );
+		drawList->AddText( { origin.x, origin.y + lane * laneStride }, IM_COL32( 255, 255, 255, 255 ), label.c_str( ) );
+	}
+
+	float x = origin.x + labelWidth;
+	for ( const TickRecord& record : timelineRecords ) {
+		float tickWidth = (float)( std::max<uint64_t>( record.end - record.start, 1 ) * scale );
+		for ( const LaneSegment& segment : record.segments ) {
+			if ( segment.end <= segment.start )
+				continue;
+			float x0 = x + (float)( ( segment.start - record.start ) * scale );
+			float x1 = x + (float)( ( segment.end - record.start ) * scale );
+			float y = origin.y + segment.lane * laneStride;
+			drawList->AddRectFilled( { x0, y }, { std::max( x1, x0 + 1.0f ), y + laneHeight }, LaneColors[segment.state] );
+		}
+		x += tickWidth;
+		drawList->AddLine( { x, origin.y }, { x, origin.y + lanes * laneStride }, IM_COL32( 255, 255, 255, 96 ) );
+	}
+	ImGui::Dummy( { labelWidth + width, lanes * laneStride } );
+
+	const char* legend[] = { "Busy", "Idle at barrier", "Stealing" };
+	for ( int i = 0; i < 3; i++ ) {
+		if ( i > 0 )
+			ImGui::SameLine( );
+		ImVec2 pos = ImGui::GetCursorScreenPos( );
+		drawList->AddRectFilled( pos, { pos.x + laneHeight, pos.y + laneHeight }, LaneColors[i] );
+		ImGui::Dummy( { laneHeight, laneHeight } );
+		ImGui::SameLine( );
+		ImGui::Text( "%s", legend[i] );
+	}
+
+	// Imbalance of the newest tick: slowest worker's busy time over the mean
+	const TickRecord& last = timelineRecords.back( );
+	std::vector<uint64_t> busy( last.lanes, 0 );
+	for ( const LaneSegment& segment : last.segments ) {
+		if ( segment.state != LaneIdle && segment.end > segment.start )
+			busy[segment.lane] += segment.end - segment.start;
+	}
+	ImGui::Text( "Last tick: %.3f ms", ( last.end - last.start ) / 1e6 );
+	if ( last.lanes > 1 ) {
+		uint64_t slowest = *std::max_element( busy.begin( ) + 1, busy.end( ) );
+		uint64_t sum = 0;
+		for ( size_t i = 1; i < busy.size( ); i++ )
+			sum += busy[i];
+		double mean = (double)sum / ( busy.size( ) - 1 );
+		ImGui::Text( "Worker imbalance: %.2fx", mean > 0 ? slowest / mean : 1.0 );
+	}
 }
\ No newline at end of file
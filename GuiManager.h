@@ -5,6 +5,9 @@
 #include "Simulation.h"
 #include "Grid.h"
 
+#include <string>
+#include <vector>
+
 class GuiManager {
 public:
 	GuiManager( Simulation& simulation );
@@ -13,6 +16,26 @@ public:
 	void Draw( );
 
 private:
+	// Draw per-lane activity of the most recent ticks
+	void DrawTimeline( );
+
 	Simulation* sim;
-	Grid* grid;
+	Rules* rules;
+	int worldSize[2] = { };				// World size being edited, applied with Resize world
+	char tracePath[256] = "life23_trace.json";
+	std::string traceStatus;
+	char patternPath[256] = "pattern.rle";
+	bool patternResizesWorld = false;	// Load resizes the world to the pattern instead of pasting into it
+	std::string patternStatus;
+	char worldPath[256] = "world.l23";
+	bool worldBitPacked = true;			// Save one bit per cell instead of one byte
+	std::string worldStatus;
+	uint32_t fieldSeed = 0;				// Seed for recreating a randomized field
+	char exportPath[256] = "life23.y4m";
+	ExportSettings exportSettings;
+	std::string exportStatus;
+	char heatmapPath[256] = "heatmap.png";
+	std::string heatmapStatus;
+	int timelineTicks = 8;
+	std::vector<TickRecord> timelineRecords;
 };
\ No newline at end of file
@@ -0,0 +1,193 @@
+// Heatmap.cpp
+
+#include "Heatmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "PixelExpand.h"
+#include "Profiler.h"
+#include "Simulation.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HEATMAP_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define HEATMAP_NEON
+#endif
+
+// Below this many cells a heat texture isn't worth spreading across threads
+static const int64_t ThreadedHeatCells = (int64_t)1 << 18;
+
+void AccumulateHeatReference( uint8_t* heat, const Cell* before, const Cell* after, int count, int decayShift ) {
+	for ( int i = 0; i < count; i++ ) {
+		int h = heat[i];
+		h = std::max( h - ( ( h >> decayShift ) | 1 ), 0 );
+		if ( before[i] != after[i] )
+			h = std::min( h + HeatGain, 255 );
+		heat[i] = (uint8_t)h;
+	}
+}
+
+void AccumulateHeat( uint8_t* heat, const Cell* before, const Cell* after, int count, int decayShift ) {
+	int i = 0;
+#if defined(HEATMAP_SSE2)
+	// There is no byte shift, so bytes are shifted as 16-bit lanes and the
+	// bits from each next byte masked off
+	const __m128i shift = _mm_cvtsi32_si128( decayShift );
+	const __m128i mask = _mm_set1_epi8( (char)( 0xFF >> decayShift ) );
+	const __m128i one = _mm_set1_epi8( 1 );
+	const __m128i gain = _mm_set1_epi8( (char)HeatGain );
+	for ( ; i + 16 <= count; i += 16 ) {
+		__m128i h = _mm_loadu_si128( (const __m128i*)( heat + i ) );
+		__m128i decay = _mm_or_si128( _mm_and_si128( _mm_srl_epi16( h, shift ), mask ), one );
+		h = _mm_subs_epu8( h, decay );
+		__m128i same = _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i*)( before + i ) ), _mm_loadu_si128( (const __m128i*)( after + i ) ) );
+		h = _mm_adds_epu8( h, _mm_andnot_si128( same, gain ) );
+		_mm_storeu_si128( (__m128i*)( heat + i ), h );
+	}
+#elif defined(HEATMAP_NEON)
+	const int8x16_t shift = vdupq_n_s8( (int8_t)-decayShift );
+	const uint8x16_t one = vdupq_n_u8( 1 );
+	const uint8x16_t gain = vdupq_n_u8( HeatGain );
+	for ( ; i + 16 <= count; i += 16 ) {
+		uint8x16_t h = vld1q_u8( heat + i );
+		h = vqsubq_u8( h, vorrq_u8( vshlq_u8( h, shift ), one ) );
+		uint8x16_t same = vceqq_u8( vld1q_u8( before + i ), vld1q_u8( after + i ) );
+		h = vqaddq_u8( h, vbicq_u8( gain, same ) );
+		vst1q_u8( heat + i, h );
+	}
+#endif
+	AccumulateHeatReference( heat + i, before + i, after + i, count - i, decayShift );
+}
+
+HeatmapLayer::~HeatmapLayer( ) {
+	// The GL context may already be gone if the window closed first
+	if ( texture.id != 0 && IsWindowReady( ) )
+		UnloadTexture( texture );
+}
+
+// Fold row into the hottest cell of each scale-wide block in [x0, x1), in block units
+static void ReduceRow( const uint8_t* row, int gridWidth, bool wrap, int x0, int x1, int scale, uint8_t* out ) {
+	for ( int block = x0; block < x1; block++ ) {
+		int start = block * scale;
+		int end = start + scale;
+		uint8_t hottest = out[block - x0];
+		if ( !wrap ) {
+			for ( int x = std::max( start, 0 ); x < std::min( end, gridWidth ); x++ )
+				hottest = std::max( hottest, row[x] );
+		} else {
+			// In pieces that each stay within one copy of the row
+			for ( int x = start; x < end; ) {
+				int source = MOD_POSITIVE( x, gridWidth );
+				int length = std::min( end - x, gridWidth - source );
+				for ( int i = 0; i < length; i++ )
+					hottest = std::max( hottest, row[source + i] );
+				x += length;
+			}
+		}
+		out[block - x0] = hottest;
+	}
+}
+
+void HeatmapLayer::Update( const GridSnapshot& snapshot, Color hot, int zoomOut, Rectangle cells, bool wrap ) {
+	if ( snapshot.Heat.empty( ) || cells.width <= 0 || cells.height <= 0 )
+		return;
+	const int scale = 1 << zoomOut;
+	const int x0 = (int)std::floor( cells.x / scale );
+	const int y0 = (int)std::floor( cells.y / scale );
+	const int x1 = (int)std::ceil( ( cells.x + cells.width ) / scale );
+	const int y1 = (int)std::ceil( ( cells.y + cells.height ) / scale );
+	source = { cells.x / scale - x0, cells.y / scale - y0, cells.width / scale, cells.height / scale };
+	const bool sameColor = hot.r == shownHot.r && hot.g == shownHot.g && hot.b == shownHot.b && hot.a == shownHot.a;
+	if ( texture.id != 0 && snapshot.Version == version && zoomOut == level && sameColor
+		&& x0 == blockX && y0 == blockY && x1 - x0 == blockWidth && y1 - y0 == blockHeight )
+		return;
+	PROFILE_ZONE( "HeatmapLayer::Update" );
+	if ( !sameColor || texture.id == 0 ) {
+		for ( int h = 0; h < 256; h++ )
+			colors[h] = PackColor( hot.r, hot.g, hot.b, (unsigned char)( h * hot.a / 255 ) );
+		shownHot = hot;
+	}
+	version = snapshot.Version;
+	level = zoomOut;
+	blockX = x0;
+	blockY = y0;
+	blockWidth = x1 - x0;
+	blockHeight = y1 - y0;
+
+	// The texture only grows, so zooming and resizing the window rarely reallocate it
+	if ( texture.id == 0 || texture.width < blockWidth || texture.height < blockHeight ) {
+		const int width = std::max( blockWidth, texture.width );
+		const int height = std::max( blockHeight, texture.height );
+		if ( texture.id != 0 )
+			UnloadTexture( texture );
+		Image image = GenImageColor( width, height, { 0, 0, 0, 0 } );
+		texture = LoadTextureFromImage( image );
+		UnloadImage( image );
+		SetTextureFilter( texture, TEXTURE_FILTER_POINT );
+	}
+
+	pixels.resize( (size_t)blockWidth * blockHeight );
+	auto expand = [&]( int start, int end ) {
+		std::vector<uint8_t> hottest( blockWidth );
+		for ( int y = start; y < end; y++ ) {
+			std::fill( hottest.begin( ), hottest.end( ), 0 );
+			for ( int cy = ( y0 + y ) * scale; cy < ( y0 + y + 1 ) * scale; cy++ ) {
+				int row = wrap ? MOD_POSITIVE( cy, snapshot.Height ) : cy;
+				if ( row < 0 || row >= snapshot.Height )
+					continue;
+				ReduceRow( snapshot.Heat.data( ) + (size_t)row * snapshot.Width, snapshot.Width, wrap, x0, x1, scale, hottest.data( ) );
+			}
+			uint32_t* out = pixels.data( ) + (size_t)y * blockWidth;
+			for ( int x = 0; x < blockWidth; x++ )
+				out[x] = colors[hottest[x]];
+		}
+	};
+	const int64_t visited = (int64_t)blockWidth * blockHeight * scale * scale;
+	int numThreads = (int)std::min<int64_t>( std::thread::hardware_concurrency( ), visited / ThreadedHeatCells );
+	numThreads = std::min( numThreads, blockHeight );
+	if ( numThreads <= 1 ) {
+		expand( 0, blockHeight );
+	} else {
+		std::vector<std::thread> threads( numThreads );
+		for ( int i = 0; i < numThreads; i++ )
+			threads[i] = std::thread( expand, blockHeight * i / numThreads, blockHeight * ( i + 1 ) / numThreads );
+		for ( auto& thread : threads ) thread.join( );
+	}
+	UpdateTextureRec( texture, { 0, 0, (float)blockWidth, (float)blockHeight }, pixels.data( ) );
+}
+
+void HeatmapLayer::Draw( Rectangle screen ) {
+	if ( texture.id == 0 )
+		return;
+	PROFILE_ZONE( "HeatmapLayer::Draw" );
+	DrawTexturePro( texture, source, screen, { 0, 0 }, 0, WHITE );
+}
+
+bool ExportHeatmap( const std::string& path, const GridSnapshot& snapshot, Color cold, Color hot, std::string& error ) {
+	if ( snapshot.Heat.empty( ) ) {
+		error = "The heatmap is off";
+		return false;
+	}
+	PROFILE_ZONE( "ExportHeatmap" );
+	Palette palette;
+	palette.Size = 256;
+	for ( int i = 0; i < palette.Size; i++ ) {
+		float t = i / 255.0f;
+		palette.Colors[i] = PackColor(
+			(unsigned char)( cold.r + ( hot.r - cold.r ) * t ),
+			(unsigned char)( cold.g + ( hot.g - cold.g ) * t ),
+			(unsigned char)( cold.b + ( hot.b - cold.b ) * t ), 255 );
+	}
+	std::vector<uint32_t> image( (size_t)snapshot.Width * snapshot.Height );
+	ExpandGrid( snapshot.Heat.data( ), snapshot.Width, snapshot.Height, 1, palette, image.data( ) );
+	Image out = { image.data( ), snapshot.Width, snapshot.Height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+	if ( !ExportImage( out, path.c_str( ) ) ) {
+		error = "Could not write " + path;
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+// Heatmap.h
+
+#pragma once
+
+#include <raylib.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Grid.h"
+
+struct GridSnapshot;
+
+// Heat a cell gains in a generation it changes, before decay
+static const int HeatGain = 64;
+
+// One generation of a row of heat: every value decays by 1/2^decayShift (and
+// at least 1), then gains HeatGain where before and after differ, saturating
+// at 255. Vectorized where the CPU allows.
+void AccumulateHeat( uint8_t* heat, const Cell* before, const Cell* after, int count, int decayShift );
+
+// Plain loop with the same results, to check the vector path against
+void AccumulateHeatReference( uint8_t* heat, const Cell* before, const Cell* after, int count, int decayShift );
+
+// Draws a snapshot's heat over the grid in one color, its opacity the heat.
+// Only the visible block is expanded and uploaded, a pixel per 2^zoomOut
+// square block of cells holding the hottest of them.
+class HeatmapLayer {
+public:
+	HeatmapLayer( ) = default;
+	~HeatmapLayer( );
+	HeatmapLayer( const HeatmapLayer& ) = delete;
+	HeatmapLayer& operator=( const HeatmapLayer& ) = delete;
+
+	// Bring the texture up to date with the visible cells of the snapshot's
+	// heat. Cells outside the grid wrap around if wrap is set, otherwise are cold.
+	void Update( const GridSnapshot& snapshot, Color hot, int zoomOut, Rectangle cells, bool wrap );
+
+	// Draw the cells last passed to Update into the screen rectangle
+	void Draw( Rectangle screen );
+
+private:
+	Texture2D texture{};
+	std::vector<uint32_t> pixels;
+	uint32_t colors[256]{};				// Heat to pixel, for shownHot
+	Color shownHot{};
+	uint64_t version = 0;				// Snapshot version the texture shows
+	int level = -1;
+	int blockX = 0;						// Blocks the texture holds, in 2^level cell units
+	int blockY = 0;
+	int blockWidth = 0;
+	int blockHeight = 0;
+	Rectangle source{};					// Texels of the visible cells
+};
+
+// Write a snapshot's heat as a PNG, a pixel per cell shading from cold to hot
+bool ExportHeatmap( const std::string& path, const GridSnapshot& snapshot, Color cold, Color hot, std::string& error );
\ No newline at end of file
@@ -0,0 +1,202 @@
+// History.cpp
+
+#include "History.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Profiler.h"
+#include "Region.h"
+
+static void PutVarint( std::vector<uint8_t>& out, uint64_t value ) {
+	while ( value >= 0x80 ) {
+		out.push_back( (uint8_t)( value | 0x80 ) );
+		value >>= 7;
+	}
+	out.push_back( (uint8_t)value );
+}
+
+static uint64_t GetVarint( const uint8_t*& in ) {
+	uint64_t value = 0;
+	for ( int shift = 0;; shift += 7 ) {
+		const uint8_t byte = *in++;
+		value |= (uint64_t)( byte & 0x7F ) << shift;
+		if ( byte < 0x80 )
+			return value;
+	}
+}
+
+// XOR a delta into words. A delta is a list of (unchanged word count, changed
+// word count, changed words) records; words after the last record are unchanged.
+static void ApplyDelta( const std::vector<uint8_t>& delta, std::vector<uint64_t>& words ) {
+	const uint8_t* in = delta.data( );
+	const uint8_t* end = in + delta.size( );
+	size_t position = 0;
+	while ( in < end ) {
+		position += GetVarint( in );
+		const uint64_t count = GetVarint( in );
+		for ( uint64_t i = 0; i < count; i++ ) {
+			uint64_t word;
+			memcpy( &word, in, 8 );
+			in += 8;
+			words[position++] ^= word;
+		}
+	}
+}
+
+void History::SetLimits( int interval, size_t budget ) {
+	keyframeInterval = std::max( interval, 1 );
+	memoryBudget = budget;
+	Evict( );
+	Publish( );
+}
+
+void History::Record( Engine& engine ) {
+	PROFILE_ZONE( "History::Record" );
+	const uint64_t generation = engine.GetGeneration( );
+	const bool restart = groups.empty( ) || engine.GetWidth( ) != width || engine.GetHeight( ) != height
+		|| generation != lastGeneration + 1;
+	if ( restart ) {
+		Clear( );
+		width = engine.GetWidth( );
+		height = engine.GetHeight( );
+		rowWords = ( width + 63 ) / 64;
+		previous.assign( (size_t)rowWords * height, 0 );
+	}
+	const bool keyframe = restart || groups.back( ).Deltas.size( ) + 1 >= (size_t)keyframeInterval;
+
+	// Bring previous up to date a changed row at a time, encoding what each
+	// word changed by unless this generation is a keyframe anyway
+	row.resize( rowWords );
+	delta.clear( );
+	uint64_t unchanged = 0;
+	changed.clear( );
+	auto flush = [&]( ) {
+		PutVarint( delta, unchanged );
+		PutVarint( delta, changed.size( ) );
+		const size_t at = delta.size( );
+		delta.resize( at + changed.size( ) * 8 );
+		memcpy( delta.data( ) + at, changed.data( ), changed.size( ) * 8 );
+		unchanged = 0;
+		changed.clear( );
+	};
+	auto rowChanged = [&]( int y ) {
+		return restart || engine.RowStamp( y ) >= recordedStamp;
+	};
+	int readStart = 0;
+	int readEnd = 0;
+	for ( int y = 0; y < height; y++ ) {
+		uint64_t* old = previous.data( ) + (size_t)y * rowWords;
+		if ( !rowChanged( y ) ) {
+			if ( !changed.empty( ) )
+				flush( );
+			unchanged += rowWords;
+			continue;
+		}
+		if ( y >= readEnd ) {
+			readStart = y;
+			readEnd = y + 1;
+			while ( readEnd < height && rowChanged( readEnd ) )
+				readEnd++;
+			engine.ReadRect( 0, readStart, width, readEnd - readStart, rows );
+		}
+		PackBits( rows.Cells.data( ) + (size_t)( y - readStart ) * width, width, row.data( ) );
+		for ( int i = 0; i < rowWords; i++ ) {
+			const uint64_t difference = row[i] ^ old[i];
+			old[i] = row[i];
+			if ( keyframe )
+				continue;
+			if ( difference != 0 ) {
+				changed.push_back( difference );
+			} else {
+				if ( !changed.empty( ) )
+					flush( );
+				unchanged++;
+			}
+		}
+	}
+	if ( !changed.empty( ) )
+		flush( );
+
+	if ( keyframe ) {
+		groups.push_back( { generation, previous, { }, previous.size( ) * 8 } );
+		bytes += groups.back( ).Bytes;
+	} else {
+		Group& group = groups.back( );
+		group.Deltas.emplace_back( delta.begin( ), delta.end( ) );
+		group.Bytes += delta.size( );
+		bytes += delta.size( );
+	}
+	lastGeneration = generation;
+	recordedStamp = engine.GetStamp( );
+	Evict( );
+	Publish( );
+}
+
+bool History::Seek( uint64_t generation, int& outWidth, int& outHeight, std::vector<Cell>& cells ) {
+	PROFILE_ZONE( "History::Seek" );
+	for ( size_t g = 0; g < groups.size( ); g++ ) {
+		Group& group = groups[g];
+		if ( generation < group.FirstGeneration || generation > group.FirstGeneration + group.Deltas.size( ) )
+			continue;
+		// Decode forward from the keyframe
+		const size_t steps = (size_t)( generation - group.FirstGeneration );
+		previous = group.Keyframe;
+		for ( size_t i = 0; i < steps; i++ )
+			ApplyDelta( group.Deltas[i], previous );
+		outWidth = width;
+		outHeight = height;
+		cells.resize( (size_t)width * height );
+		for ( int y = 0; y < height; y++ )
+			UnpackBits( previous.data( ) + (size_t)y * rowWords, width, cells.data( ) + (size_t)y * width );
+
+		// Everything after the generation sought is a future that won't happen now
+		for ( size_t i = steps; i < group.Deltas.size( ); i++ )
+			group.Bytes -= group.Deltas[i].size( );
+		group.Deltas.resize( steps );
+		groups.erase( groups.begin( ) + g + 1, groups.end( ) );
+		bytes = 0;
+		for ( const Group& kept : groups )
+			bytes += kept.Bytes;
+		lastGeneration = generation;
+		Publish( );
+		return true;
+	}
+	return false;
+}
+
+void History::Clear( ) {
+	groups.clear( );
+	previous.clear( );
+	width = 0;
+	height = 0;
+	rowWords = 0;
+	bytes = 0;
+	Publish( );
+}
+
+void History::Evict( ) {
+	// The newest group is kept whatever it costs, so there is always somewhere to go back to
+	while ( bytes > memoryBudget && groups.size( ) > 1 ) {
+		bytes -= groups.front( ).Bytes;
+		groups.pop_front( );
+	}
+}
+
+void History::Publish( ) {
+	oldest = groups.empty( ) ? 1 : groups.front( ).FirstGeneration;
+	newest = groups.empty( ) ? 0 : groups.back( ).FirstGeneration + groups.back( ).Deltas.size( );
+	memoryUsed = bytes;
+}
+
+uint64_t History::Oldest( ) const {
+	return oldest;
+}
+
+uint64_t History::Newest( ) const {
+	return newest;
+}
+
+size_t History::MemoryUsed( ) const {
+	return memoryUsed;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+// History.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Engine.h"
+#include "Grid.h"
+
+// Bounded record of past generations for rewinding. Every keyframe interval
+// the whole grid is stored bit-packed; each generation in between is stored
+// as its XOR with the one before, as runs of unchanged words and the changed
+// words themselves. Whole keyframe groups are dropped oldest first to stay
+// within the memory budget.
+// Recording and seeking belong to the simulation thread; the stored range and
+// memory use may be read from any thread.
+class History {
+public:
+	History( ) = default;
+	History( const History& ) = delete;
+	History& operator=( const History& ) = delete;
+
+	void SetLimits( int keyframeInterval, size_t memoryBudget );
+
+	// Store the engine's current generation. Rows not stamped since the last
+	// call are taken as unchanged; runs of changed ones are read in one block.
+	// A new size or a generation that doesn't follow the last one starts the
+	// history over.
+	void Record( Engine& engine );
+
+	// Rebuild a stored generation into cells. The history is cut back to end
+	// there, so recording carries on from it. False if it isn't stored.
+	bool Seek( uint64_t generation, int& width, int& height, std::vector<Cell>& cells );
+
+	void Clear( );
+
+	// Stored generations, both ends included; Oldest > Newest when empty
+	uint64_t Oldest( ) const;
+	uint64_t Newest( ) const;
+	size_t MemoryUsed( ) const;
+
+private:
+	struct Group {
+		uint64_t FirstGeneration;				// Generation of the keyframe
+		std::vector<uint64_t> Keyframe;
+		std::vector<std::vector<uint8_t>> Deltas;	// Generations after the keyframe, in order
+		size_t Bytes;
+	};
+
+	void Evict( );
+	void Publish( );
+
+	std::deque<Group> groups;
+	std::vector<uint64_t> previous;			// Packed grid as last recorded, rowWords per row
+	std::vector<uint64_t> row;				// Scratch for Record
+	Pattern rows;
+	std::vector<uint64_t> changed;
+	std::vector<uint8_t> delta;
+	int width = 0;
+	int height = 0;
+	int rowWords = 0;
+	uint64_t lastGeneration = 0;
+	uint64_t recordedStamp = 0;				// Engine stamp when last recorded
+	int keyframeInterval = 64;
+	size_t memoryBudget = (size_t)256 << 20;
+	size_t bytes = 0;
+
+	std::atomic<uint64_t> oldest{ 1 };
+	std::atomic<uint64_t> newest{ 0 };
+	std::atomic<size_t> memoryUsed{ 0 };
+};
\ No newline at end of file
@@ -8,12 +8,57 @@
 #include <raylib.h>
 #include <rlgl.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
+#include "Benchmark.h"
+#include "FrameExport.h"
 #include "Simulation.h"
 #include "GuiManager.h"
+#include "Profiler.h"
 
 int main( int argc, char* argv[] ) {
+	std::string tracePath;
+	int benchmarkTicks = 0;
+	int benchmarkWidth = 1024;
+	int benchmarkHeight = 1024;
+	ExportSettings exportSettings;
+	int exportGenerations = 0;
+	std::string exportWorld;
+	for ( int i = 1; i < argc; i++ ) {
+		// --trace <file> captures from startup and writes a Chrome trace on exit
+		if ( strcmp( argv[i], "--trace" ) == 0 && i + 1 < argc )
+			tracePath = argv[++i];
+		// --benchmark <ticks> [--size <w>x<h>] times the tick paths headless and exits
+		else if ( strcmp( argv[i], "--benchmark" ) == 0 && i + 1 < argc )
+			benchmarkTicks = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "--size" ) == 0 && i + 1 < argc )
+			sscanf( argv[++i], "%dx%d", &benchmarkWidth, &benchmarkHeight );
+		// --export <file> <generations> [--every <n>] [--scale <s>] [--world <snapshot>]
+		// writes frames headless and exits; --size sets the random world's size
+		else if ( strcmp( argv[i], "--export" ) == 0 && i + 2 < argc ) {
+			exportSettings.Path = argv[++i];
+			exportGenerations = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "--every" ) == 0 && i + 1 < argc )
+			exportSettings.Every = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "--scale" ) == 0 && i + 1 < argc )
+			exportSettings.Scale = atoi( argv[++i] );
+		else if ( strcmp( argv[i], "--world" ) == 0 && i + 1 < argc )
+			exportWorld = argv[++i];
+	}
+	if ( benchmarkTicks > 0 )
+		return RunBenchmark( benchmarkWidth, benchmarkHeight, benchmarkTicks );
+	if ( !exportSettings.Path.empty( ) ) {
+		// Colors of the default window: white on black
+		exportSettings.Colors.Colors[0] = PackColor( 0, 0, 0, 255 );
+		exportSettings.Colors.Colors[1] = PackColor( 255, 255, 255, 255 );
+		return RunExport( exportSettings, benchmarkWidth, benchmarkHeight, exportGenerations, exportWorld );
+	}
+	if ( !tracePath.empty( ) )
+		Profiler::SetCapturing( true );
+	Profiler::SetThreadName( "Main" );
 	SetConfigFlags( FLAG_WINDOW_RESIZABLE );
 	InitWindow( 1600, 900, "Life23" );
 	// SetTargetFPS( 60 );
@@ -23,17 +68,32 @@ int main( int argc, char* argv[] ) {
 	ImGui::GetIO( ).IniFilename = NULL;
 	ImGui::GetIO( ).LogFilename = NULL;
 	while ( !WindowShouldClose( ) ) {
+		PROFILE_ZONE( "Frame" );
 		auto& io = ImGui::GetIO( );
-		sim.Update( io.WantCaptureKeyboard, io.WantCaptureMouse );
+		{
+			PROFILE_ZONE( "Simulation::Update" );
+			sim.Update( io.WantCaptureKeyboard, io.WantCaptureMouse );
+		}
 		BeginDrawing( );
 		rlImGuiBegin( );
 		sim.Draw( io.WantCaptureMouse );
-		gui.Draw( );
-		rlImGuiEnd( );
+		{
+			PROFILE_ZONE( "GuiManager::Draw" );
+			gui.Draw( );
+		}
+		{
+			PROFILE_ZONE( "rlImGuiEnd" );
+			rlImGuiEnd( );
+		}
 		DrawCircle( GetMouseX( ), GetMouseY( ), 4, { 255, 255, 255, 255 } );
 		DrawCircle( GetMouseX( ), GetMouseY( ), 3, { 255, 0, 255, 255 } );
-		EndDrawing( );
+		{
+			PROFILE_ZONE( "EndDrawing" );
+			EndDrawing( );
+		}
 	}
+	if ( !tracePath.empty( ) )
+		Profiler::ExportChromeTrace( tracePath );
 	rlImGuiShutdown( );
 	CloseWindow( );
 	return 0;
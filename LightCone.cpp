@@ -0,0 +1,214 @@
+// LightCone.cpp
+
+#include "LightCone.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Profiler.h"
+
+// Cells a step works out before its rows are split across threads
+static const int64_t ThreadedStepCells = (int64_t)1 << 16;
+
+bool LightConeQuery::operator==( const LightConeQuery& other ) const {
+	return X == other.X && Y == other.Y && Width == other.Width && Height == other.Height
+		&& Generations == other.Generations && ConeRules == other.ConeRules && Generation == other.Generation;
+}
+
+LightCone::~LightCone( ) {
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		stopping = true;
+		cancel = true;
+	}
+	wake.notify_one( );
+	if ( worker.joinable( ) )
+		worker.join( );
+}
+
+void LightCone::Request( const LightConeQuery& query, const Cell* cells, int gridWidth, int gridHeight ) {
+	PROFILE_ZONE( "LightCone::Request" );
+	Job job;
+	job.Query = query;
+	job.GridWidth = gridWidth;
+	job.GridHeight = gridHeight;
+	const bool wrap = query.ConeRules.EdgeBehavior == Wrap;
+	const int n = query.Generations;
+	int x0 = query.X - n;
+	int y0 = query.Y - n;
+	int x1 = query.X + query.Width + n;
+	int y1 = query.Y + query.Height + n;
+	if ( wrap && (int64_t)( x1 - x0 ) * ( y1 - y0 ) >= (int64_t)gridWidth * gridHeight ) {
+		// Cheaper to run the whole world than a cone that covers it more than once
+		job.WholeWorld = true;
+		CopyBlock( cells, gridWidth, gridHeight, false, 0, 0, gridWidth, gridHeight, job.Source );
+	} else {
+		if ( !wrap ) {
+			// Past the edges cells are dead for good, so the cone stops there
+			x0 = std::max( x0, 0 );
+			y0 = std::max( y0, 0 );
+			x1 = std::min( x1, gridWidth );
+			y1 = std::min( y1, gridHeight );
+		}
+		job.SourceX = x0;
+		job.SourceY = y0;
+		// The border is read only where the cone was cut off, and is dead there
+		CopyBlock( cells, gridWidth, gridHeight, wrap, x0 - 1, y0 - 1, std::max( x1 - x0, 0 ) + 2, std::max( y1 - y0, 0 ) + 2, job.Source );
+	}
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		pending = std::move( job );
+		hasPending = true;
+		cancel = true;
+		busy = true;
+		if ( !worker.joinable( ) )
+			worker = std::thread( &LightCone::Work, this );
+	}
+	wake.notify_one( );
+}
+
+bool LightCone::Collect( LightConeQuery& query, Pattern& block ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	if ( !hasDone )
+		return false;
+	query = doneQuery;
+	block = std::move( done );
+	hasDone = false;
+	return true;
+}
+
+bool LightCone::Busy( ) const {
+	return busy;
+}
+
+void LightCone::Work( ) {
+	Profiler::SetThreadName( "Light cone" );
+	std::unique_lock<std::mutex> lock( mutex );
+	for ( ;; ) {
+		wake.wait( lock, [this] { return hasPending || stopping; } );
+		if ( stopping )
+			return;
+		Job job = std::move( pending );
+		hasPending = false;
+		cancel = false;
+		lock.unlock( );
+
+		Pattern block;
+		const bool finished = Evaluate( job, block );
+		lock.lock( );
+		if ( finished && !hasPending ) {
+			doneQuery = job.Query;
+			done = std::move( block );
+			hasDone = true;
+		}
+		busy = hasPending;
+	}
+}
+
+// One generation of rows [startRow, endRow), columns [startColumn, endColumn)
+// of a stride-wide buffer. Every cell read lies inside the buffer.
+static void StepRows( const Cell* in, Cell* out, int stride, int startRow, int endRow, int startColumn, int endColumn,
+	const Rules& rules, const std::atomic<bool>& cancel ) {
+	const int dx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+	const int dy[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+	int offsets[8];
+	int count = 0;
+	for ( int i = 0; i < 8; i++ ) {
+		if ( rules.Neighborhood[i] )
+			offsets[count++] = dy[i] * stride + dx[i];
+	}
+	for ( int y = startRow; y < endRow && !cancel; y++ ) {
+		const Cell* row = in + (size_t)y * stride;
+		Cell* target = out + (size_t)y * stride;
+		if ( count == 8 ) {
+			// The usual full neighborhood, summed straight from the three rows
+			const Cell* up = row - stride;
+			const Cell* down = row + stride;
+			for ( int x = startColumn; x < endColumn; x++ ) {
+				const int sum = up[x - 1] + up[x] + up[x + 1] + row[x - 1] + row[x + 1] + down[x - 1] + down[x] + down[x + 1];
+				target[x] = row[x] ? rules.SurviveRule[sum] : rules.BirthRule[sum];
+			}
+			continue;
+		}
+		for ( int x = startColumn; x < endColumn; x++ ) {
+			int sum = 0;
+			for ( int i = 0; i < count; i++ )
+				sum += row[x + offsets[i]];
+			target[x] = row[x] ? rules.SurviveRule[sum] : rules.BirthRule[sum];
+		}
+	}
+}
+
+bool LightCone::Evaluate( Job& job, Pattern& block ) {
+	PROFILE_ZONE( "LightCone::Evaluate" );
+	const LightConeQuery& query = job.Query;
+	if ( job.WholeWorld ) {
+		Grid world( 0, 0 );
+		world.Load( job.GridWidth, job.GridHeight, job.Source.Cells );
+		world.SetRules( query.ConeRules );
+		for ( int i = 0; i < query.Generations; i++ ) {
+			if ( cancel )
+				return false;
+			world.TickWithMultithreading( );
+		}
+		world.CopyBlock( query.X, query.Y, query.Width, query.Height, block );
+		return true;
+	}
+
+	// Buffer coordinates are grid coordinates less the source origin, plus the border
+	const int stride = job.Source.Width;
+	const int rows = job.Source.Height;
+	std::vector<Cell> front = std::move( job.Source.Cells );
+	std::vector<Cell> back = front;
+	const bool wrap = query.ConeRules.EdgeBehavior == Wrap;
+	const int left = query.X - job.SourceX + 1;
+	const int top = query.Y - job.SourceY + 1;
+	for ( int k = 1; k <= query.Generations; k++ ) {
+		// The cone this generation, cut to the buffer where the grid's edges cut it
+		const int reach = query.Generations - k;
+		int startColumn = left - reach;
+		int endColumn = left + query.Width + reach;
+		int startRow = top - reach;
+		int endRow = top + query.Height + reach;
+		if ( !wrap ) {
+			startColumn = std::max( startColumn, 1 );
+			startRow = std::max( startRow, 1 );
+			endColumn = std::min( endColumn, stride - 1 );
+			endRow = std::min( endRow, rows - 1 );
+		}
+		const int64_t cells = (int64_t)std::max( endColumn - startColumn, 0 ) * std::max( endRow - startRow, 0 );
+		int numThreads = (int)std::min<int64_t>( std::thread::hardware_concurrency( ), cells / ThreadedStepCells );
+		numThreads = std::min( numThreads, endRow - startRow );
+		if ( numThreads <= 1 ) {
+			StepRows( front.data( ), back.data( ), stride, startRow, endRow, startColumn, endColumn, query.ConeRules, cancel );
+		} else {
+			std::vector<std::thread> threads( numThreads );
+			for ( int i = 0; i < numThreads; i++ ) {
+				int start = startRow + ( endRow - startRow ) * i / numThreads;
+				int end = startRow + ( endRow - startRow ) * ( i + 1 ) / numThreads;
+				threads[i] = std::thread( StepRows, front.data( ), back.data( ), stride, start, end, startColumn, endColumn,
+					std::cref( query.ConeRules ), std::cref( cancel ) );
+			}
+			for ( auto& thread : threads ) thread.join( );
+		}
+		if ( cancel )
+			return false;
+		std::swap( front, back );
+	}
+
+	// The block is what is left of the cone; without wrapping, parts of it
+	// past the edges are dead
+	block.Width = query.Width;
+	block.Height = query.Height;
+	block.Cells.assign( (size_t)query.Width * query.Height, 0 );
+	const int startColumn = std::max( left, 1 );
+	const int endColumn = std::min( left + query.Width, stride - 1 );
+	for ( int y = 0; y < query.Height; y++ ) {
+		const int row = top + y;
+		if ( row < 1 || row >= rows - 1 || endColumn <= startColumn )
+			continue;
+		memcpy( block.Cells.data( ) + (size_t)y * query.Width + ( startColumn - left ),
+			front.data( ) + (size_t)row * stride + startColumn, endColumn - startColumn );
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+// LightCone.h
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Grid.h"
+#include "Region.h"
+
+// A block of cells some generations ahead of a grid, computed from only the
+// cells it depends on: its backward light cone, the block grown by one cell a
+// side per generation. Each generation works out a ring less than the one
+// before, so the cost grows with (block + 2 * generations)^2 rather than with
+// the world. Without wrapping the cone is cut off at the grid's edges, where
+// cells stay dead; with wrapping, a cone larger than the world falls back to
+// running the whole world.
+struct LightConeQuery {
+	int X = 0;							// Block, in grid cells; may leave the grid when wrapping
+	int Y = 0;
+	int Width = 0;
+	int Height = 0;
+	int Generations = 0;
+	Rules ConeRules{};
+	uint64_t Generation = 0;			// Generation of the cells the query starts from
+
+	bool operator==( const LightConeQuery& other ) const;
+	bool operator!=( const LightConeQuery& other ) const { return !( *this == other ); }
+};
+
+// Computes queries on a worker thread of its own. A new query supersedes the
+// one in progress, so the caller can ask every frame without waiting.
+// Request and Collect belong to one thread; Busy may be read from any.
+class LightCone {
+public:
+	LightCone( ) = default;
+	LightCone( const LightCone& ) = delete;
+	LightCone& operator=( const LightCone& ) = delete;
+	~LightCone( );
+
+	// Copy the cells query depends on out of a gridWidth x gridHeight grid
+	// and start working it out, abandoning any query still in progress
+	void Request( const LightConeQuery& query, const Cell* cells, int gridWidth, int gridHeight );
+
+	// Hand over the newest finished block, once; false if none finished since
+	// the last call
+	bool Collect( LightConeQuery& query, Pattern& block );
+
+	bool Busy( ) const;
+
+private:
+	struct Job {
+		LightConeQuery Query;
+		Pattern Source;					// Cone cells with a dead border, or the whole world
+		int SourceX = 0;				// Grid position of Source's first cell inside the border
+		int SourceY = 0;
+		bool WholeWorld = false;
+		int GridWidth = 0;
+		int GridHeight = 0;
+	};
+
+	void Work( );
+	// False if abandoned for a newer query
+	bool Evaluate( Job& job, Pattern& block );
+
+	std::thread worker;
+	std::mutex mutex;					// Guards everything below up to the atomics
+	std::condition_variable wake;
+	Job pending;
+	bool hasPending = false;
+	bool stopping = false;
+	LightConeQuery doneQuery;
+	Pattern done;
+	bool hasDone = false;
+
+	std::atomic<bool> cancel{ false };	// Set when a newer query arrives
+	std::atomic<bool> busy{ false };
+};
\ No newline at end of file
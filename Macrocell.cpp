@@ -0,0 +1,403 @@
+// Macrocell.cpp
+
+#include "Macrocell.h"
+
+#include <algorithm>
+#include <bitset>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "Profiler.h"
+#include "Rle.h"
+
+// Least leaf rows worth handing to another thread when building
+static const int ThreadedLeafRows = 64;
+
+bool Quadtree::NodeKey::operator==( const NodeKey& other ) const {
+	return Level == other.Level && Bits == other.Bits
+		&& std::equal( Children, Children + 4, other.Children );
+}
+
+size_t Quadtree::NodeKeyHash::operator()( const NodeKey& key ) const {
+	uint64_t hash = (uint64_t)key.Level;
+	for ( uint32_t child : key.Children )
+		hash = ( hash ^ child ) * 0x9E3779B97F4A7C15ULL;
+	hash = ( hash ^ key.Bits ) * 0x9E3779B97F4A7C15ULL;
+	return (size_t)( hash ^ ( hash >> 29 ) );
+}
+
+Quadtree::Quadtree( ) {
+	Clear( );
+}
+
+void Quadtree::Clear( ) {
+	nodes.assign( 1, NodeData{ 0, { 0, 0, 0, 0 }, 0, 0 } );
+	index.clear( );
+	bounds.clear( );
+	boundsKnown.clear( );
+	Root = 0;
+	RootLevel = LeafLevel;
+}
+
+uint32_t Quadtree::Intern( const NodeKey& key, uint64_t population ) {
+	auto found = index.find( key );
+	if ( found != index.end( ) )
+		return found->second;
+	const uint32_t id = (uint32_t)nodes.size( );
+	nodes.push_back( { key.Level, { key.Children[0], key.Children[1], key.Children[2], key.Children[3] }, key.Bits, population } );
+	index.emplace( key, id );
+	return id;
+}
+
+uint32_t Quadtree::Leaf( uint64_t bits ) {
+	if ( bits == 0 )
+		return 0;
+	return Intern( { LeafLevel, { 0, 0, 0, 0 }, bits }, std::bitset<64>( bits ).count( ) );
+}
+
+uint32_t Quadtree::Node( int level, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se ) {
+	if ( ( nw | ne | sw | se ) == 0 )
+		return 0;
+	uint64_t population = nodes[nw].Population + nodes[ne].Population + nodes[sw].Population + nodes[se].Population;
+	return Intern( { level, { nw, ne, sw, se }, 0 }, population );
+}
+
+int Quadtree::Level( uint32_t node ) const {
+	return nodes[node].Level;
+}
+
+const uint32_t* Quadtree::Children( uint32_t node ) const {
+	return nodes[node].Children;
+}
+
+uint64_t Quadtree::Bits( uint32_t node ) const {
+	return nodes[node].Bits;
+}
+
+uint64_t Quadtree::Population( uint32_t node ) const {
+	return nodes[node].Population;
+}
+
+size_t Quadtree::NodeCount( ) const {
+	return nodes.size( );
+}
+
+void Quadtree::Build( const Cell* cells, int width, int height ) {
+	PROFILE_ZONE( "Quadtree::Build" );
+	Clear( );
+	if ( width <= 0 || height <= 0 )
+		return;
+	int level = LeafLevel;
+	while ( ( (int64_t)1 << level ) < std::max( width, height ) )
+		level++;
+
+	// Gather leaf bitmasks in bands of leaf rows across threads; interning
+	// them has to be done in one place
+	int columns = ( width + 7 ) / 8;
+	int rows = ( height + 7 ) / 8;
+	std::vector<uint64_t> leafBits( (size_t)columns * rows );
+	auto gather = [&]( int startRow, int endRow ) {
+		for ( int leafY = startRow; leafY < endRow; leafY++ ) {
+			uint64_t* out = leafBits.data( ) + (size_t)leafY * columns;
+			for ( int r = 0; r < 8 && leafY * 8 + r < height; r++ ) {
+				const Cell* row = cells + (size_t)( leafY * 8 + r ) * width;
+				for ( int leafX = 0; leafX < columns; leafX++ ) {
+					const int x = leafX * 8;
+					out[leafX] |= (uint64_t)PackByte( row + x, std::min( 8, width - x ) ) << ( r * 8 );
+				}
+			}
+		}
+	};
+	const int numThreads = std::max( 1, std::min( (int)std::thread::hardware_concurrency( ), rows / ThreadedLeafRows ) );
+	std::vector<std::thread> threads;
+	for ( int i = 0; i < numThreads; i++ ) {
+		int startRow = rows * i / numThreads;
+		int endRow = rows * ( i + 1 ) / numThreads;
+		if ( i == numThreads - 1 )
+			gather( startRow, endRow );
+		else
+			threads.emplace_back( gather, startRow, endRow );
+	}
+	for ( auto& thread : threads ) thread.join( );
+
+	std::vector<uint32_t> ids( leafBits.size( ) );
+	for ( size_t i = 0; i < leafBits.size( ); i++ )
+		ids[i] = Leaf( leafBits[i] );
+
+	// Each level up pairs off rows and columns of the one below, with empty
+	// nodes past the edges
+	for ( int k = LeafLevel + 1; k <= level; k++ ) {
+		const int parentColumns = ( columns + 1 ) / 2;
+		const int parentRows = ( rows + 1 ) / 2;
+		std::vector<uint32_t> parents( (size_t)parentColumns * parentRows );
+		auto child = [&]( int x, int y ) {
+			return x < columns && y < rows ? ids[(size_t)y * columns + x] : 0;
+		};
+		for ( int y = 0; y < parentRows; y++ ) {
+			for ( int x = 0; x < parentColumns; x++ ) {
+				parents[(size_t)y * parentColumns + x] = Node( k,
+					child( x * 2, y * 2 ), child( x * 2 + 1, y * 2 ),
+					child( x * 2, y * 2 + 1 ), child( x * 2 + 1, y * 2 + 1 ) );
+			}
+		}
+		ids.swap( parents );
+		columns = parentColumns;
+		rows = parentRows;
+	}
+	Root = ids[0];
+	RootLevel = level;
+}
+
+const Quadtree::NodeBounds& Quadtree::BoundsOf( uint32_t node ) {
+	NodeBounds& result = bounds[node];
+	if ( boundsKnown[node] )
+		return result;
+	const NodeData& data = nodes[node];
+	result = { INT64_MAX, INT64_MAX, INT64_MIN, INT64_MIN };
+	if ( data.Level == LeafLevel ) {
+		for ( int i = 0; i < 64; i++ ) {
+			if ( !( ( data.Bits >> i ) & 1 ) )
+				continue;
+			result.MinX = std::min<int64_t>( result.MinX, i % 8 );
+			result.MinY = std::min<int64_t>( result.MinY, i / 8 );
+			result.MaxX = std::max<int64_t>( result.MaxX, i % 8 );
+			result.MaxY = std::max<int64_t>( result.MaxY, i / 8 );
+		}
+	} else {
+		const int64_t half = (int64_t)1 << ( data.Level - 1 );
+		for ( int i = 0; i < 4; i++ ) {
+			if ( data.Children[i] == 0 )
+				continue;
+			const NodeBounds& inner = BoundsOf( data.Children[i] );
+			const int64_t offsetX = ( i & 1 ) * half;
+			const int64_t offsetY = ( i >> 1 ) * half;
+			result.MinX = std::min( result.MinX, inner.MinX + offsetX );
+			result.MinY = std::min( result.MinY, inner.MinY + offsetY );
+			result.MaxX = std::max( result.MaxX, inner.MaxX + offsetX );
+			result.MaxY = std::max( result.MaxY, inner.MaxY + offsetY );
+		}
+	}
+	boundsKnown[node] = true;
+	return result;
+}
+
+bool Quadtree::Bounds( int64_t& x, int64_t& y, int64_t& width, int64_t& height ) {
+	if ( Root == 0 )
+		return false;
+	// Nodes are never removed, so bounds found before stay good
+	bounds.resize( nodes.size( ) );
+	boundsKnown.resize( nodes.size( ), false );
+	const NodeBounds& root = BoundsOf( Root );
+	x = root.MinX;
+	y = root.MinY;
+	width = root.MaxX - root.MinX + 1;
+	height = root.MaxY - root.MinY + 1;
+	return true;
+}
+
+void Quadtree::Materialize( int64_t x, int64_t y, int width, int height, Pattern& out ) const {
+	PROFILE_ZONE( "Quadtree::Materialize" );
+	out.Width = width;
+	out.Height = height;
+	out.Cells.assign( (size_t)width * height, 0 );
+	if ( Root != 0 )
+		MaterializeNode( Root, 0, 0, x, y, out );
+}
+
+void Quadtree::MaterializeNode( uint32_t node, int64_t nodeX, int64_t nodeY, int64_t x, int64_t y, Pattern& out ) const {
+	const NodeData& data = nodes[node];
+	const int64_t size = (int64_t)1 << data.Level;
+	if ( nodeX >= x + out.Width || nodeY >= y + out.Height || nodeX + size <= x || nodeY + size <= y )
+		return;
+	if ( data.Level == LeafLevel ) {
+		const int64_t left = nodeX - x;
+		const int64_t top = nodeY - y;
+		if ( left >= 0 && top >= 0 && left + 8 <= out.Width && top + 8 <= out.Height ) {
+			for ( int r = 0; r < 8; r++ ) {
+				const uint8_t row = (uint8_t)( data.Bits >> ( r * 8 ) );
+				if ( row )
+					UnpackByte( row, &out.Cells[(size_t)( top + r ) * out.Width + left] );
+			}
+			return;
+		}
+		// A leaf on the window's edge, cell by cell
+		for ( int i = 0; i < 64; i++ ) {
+			const int64_t cellX = nodeX + i % 8 - x;
+			const int64_t cellY = nodeY + i / 8 - y;
+			if ( ( ( data.Bits >> i ) & 1 ) && cellX >= 0 && cellY >= 0 && cellX < out.Width && cellY < out.Height )
+				out.Cells[(size_t)cellY * out.Width + cellX] = 1;
+		}
+		return;
+	}
+	const int64_t half = size / 2;
+	for ( int i = 0; i < 4; i++ ) {
+		if ( data.Children[i] != 0 )
+			MaterializeNode( data.Children[i], nodeX + ( i & 1 ) * half, nodeY + ( i >> 1 ) * half, x, y, out );
+	}
+}
+
+// One line without its line ending; false at the end of the file
+static bool ReadLine( FILE* file, std::string& line ) {
+	line.clear( );
+	char buffer[256];
+	while ( fgets( buffer, sizeof( buffer ), file ) ) {
+		line += buffer;
+		if ( !line.empty( ) && line.back( ) == '\n' )
+			break;
+	}
+	if ( line.empty( ) && feof( file ) )
+		return false;
+	while ( !line.empty( ) && ( line.back( ) == '\n' || line.back( ) == '\r' ) )
+		line.pop_back( );
+	return true;
+}
+
+bool ReadMacrocell( const std::string& path, MacrocellFile& out, std::string& error ) {
+	PROFILE_ZONE( "ReadMacrocell" );
+	FILE* file = fopen( path.c_str( ), "rb" );
+	if ( !file ) {
+		error = "Could not open " + path;
+		return false;
+	}
+	out.Tree.Clear( );
+	out.HasRule = false;
+	out.Generation = 0;
+	std::string line;
+	if ( !ReadLine( file, line ) || line.compare( 0, 4, "[M2]" ) != 0 ) {
+		fclose( file );
+		error = path + " is not a macrocell file";
+		return false;
+	}
+
+	// Nodes are numbered from 1 in file order, 0 meaning empty; remember what
+	// each number was interned as and its level
+	std::vector<uint32_t> ids( 1, 0 );
+	std::vector<int> levels( 1, 0 );
+	int lineNumber = 1;
+	auto fail = [&]( const char* reason ) {
+		fclose( file );
+		error = path + ":" + std::to_string( lineNumber ) + ": " + reason;
+		return false;
+	};
+	while ( ReadLine( file, line ) ) {
+		lineNumber++;
+		if ( line.empty( ) )
+			continue;
+		const char first = line[0];
+		if ( first == '#' ) {
+			if ( line.compare( 0, 2, "#R" ) == 0 )
+				out.HasRule = ParseRule( line.substr( 2 ), out.BirthRule, out.SurviveRule );
+			else if ( line.compare( 0, 2, "#G" ) == 0 )
+				out.Generation = strtoull( line.c_str( ) + 2, nullptr, 10 );
+		} else if ( first == '.' || first == '*' || first == '$' ) {
+			uint64_t bits = 0;
+			int x = 0;
+			int y = 0;
+			for ( char c : line ) {
+				if ( c == '$' ) {
+					x = 0;
+					y++;
+					continue;
+				}
+				if ( c != '.' && c != '*' )
+					continue;
+				if ( x >= 8 || y >= 8 )
+					return fail( "leaf is larger than 8x8" );
+				if ( c == '*' )
+					bits |= (uint64_t)1 << ( y * 8 + x );
+				x++;
+			}
+			ids.push_back( out.Tree.Leaf( bits ) );
+			levels.push_back( Quadtree::LeafLevel );
+		} else if ( first >= '0' && first <= '9' ) {
+			int level;
+			unsigned long children[4];
+			if ( sscanf( line.c_str( ), "%d %lu %lu %lu %lu", &level, &children[0], &children[1], &children[2], &children[3] ) != 5 )
+				return fail( "node needs a level and four children" );
+			if ( level <= Quadtree::LeafLevel || level > Quadtree::MaxLevel )
+				return fail( "node level out of range; only two-state patterns are supported" );
+			uint32_t interned[4];
+			for ( int i = 0; i < 4; i++ ) {
+				if ( children[i] >= ids.size( ) || ( children[i] != 0 && levels[children[i]] != level - 1 ) )
+					return fail( "node refers to a missing or mismatched child" );
+				interned[i] = ids[children[i]];
+			}
+			ids.push_back( out.Tree.Node( level, interned[0], interned[1], interned[2], interned[3] ) );
+			levels.push_back( level );
+		} else {
+			return fail( "unrecognized line" );
+		}
+	}
+	fclose( file );
+	if ( ids.size( ) == 1 ) {
+		error = path + " has no nodes";
+		return false;
+	}
+	// The last node is the root
+	out.Tree.Root = ids.back( );
+	out.Tree.RootLevel = levels.back( );
+	return true;
+}
+
+// Write node and everything under it not yet written, children first, giving
+// each its line number in numbers
+static bool WriteNode( FILE* file, const Quadtree& tree, uint32_t node, std::vector<uint32_t>& numbers, uint32_t& written ) {
+	if ( node == 0 || numbers[node] != 0 )
+		return true;
+	const int level = tree.Level( node );
+	if ( level == Quadtree::LeafLevel ) {
+		// Rows end with '$'; trailing dead cells and rows are left out
+		const uint64_t bits = tree.Bits( node );
+		char text[8 * 9 + 2];
+		int length = 0;
+		int lastRow = 7;
+		while ( ( ( bits >> ( lastRow * 8 ) ) & 0xFF ) == 0 )
+			lastRow--;
+		for ( int y = 0; y <= lastRow; y++ ) {
+			const uint64_t row = ( bits >> ( y * 8 ) ) & 0xFF;
+			for ( int x = 0; ( row >> x ) != 0; x++ )
+				text[length++] = ( ( row >> x ) & 1 ) ? '*' : '.';
+			text[length++] = '$';
+		}
+		text[length++] = '\n';
+		if ( fwrite( text, 1, length, file ) != (size_t)length )
+			return false;
+	} else {
+		const uint32_t* children = tree.Children( node );
+		for ( int i = 0; i < 4; i++ ) {
+			if ( !WriteNode( file, tree, children[i], numbers, written ) )
+				return false;
+		}
+		if ( fprintf( file, "%d %u %u %u %u\n", level,
+			numbers[children[0]], numbers[children[1]], numbers[children[2]], numbers[children[3]] ) < 0 )
+			return false;
+	}
+	numbers[node] = ++written;
+	return true;
+}
+
+bool WriteMacrocell( const std::string& path, const Quadtree& tree, const Rules& rules, uint64_t generation, std::string& error ) {
+	PROFILE_ZONE( "WriteMacrocell" );
+	FILE* file = fopen( path.c_str( ), "wb" );
+	if ( !file ) {
+		error = "Could not write " + path;
+		return false;
+	}
+	fprintf( file, "[M2] (Life23)\n#R %s\n#G %llu\n", FormatRule( rules ).c_str( ), (unsigned long long)generation );
+
+	std::vector<uint32_t> numbers( tree.NodeCount( ), 0 );
+	uint32_t written = 0;
+	bool ok = WriteNode( file, tree, tree.Root, numbers, written );
+	// Readers expect the root to be a node, not a bare leaf or nothing at all
+	if ( ok && tree.Root == 0 )
+		ok = fprintf( file, "%d 0 0 0 0\n", std::max( tree.RootLevel, Quadtree::LeafLevel + 1 ) ) > 0;
+	else if ( ok && tree.Level( tree.Root ) == Quadtree::LeafLevel )
+		ok = fprintf( file, "%d %u 0 0 0\n", Quadtree::LeafLevel + 1, numbers[tree.Root] ) > 0;
+	if ( fclose( file ) != 0 || !ok ) {
+		error = "Could not write " + path;
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
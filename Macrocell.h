@@ -0,0 +1,94 @@
+// Macrocell.h
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Grid.h"
+#include "Region.h"
+
+// A square pattern of side 2^level as a quadtree whose nodes are hash-consed:
+// every distinct subtree is stored once, however often it repeats, so huge
+// regular patterns take memory in proportion to their variety, not their area.
+// Node 0 is empty at every level; 8x8 leaves (level 3) are stored as bitmasks.
+class Quadtree {
+public:
+	static constexpr int LeafLevel = 3;
+	// Coordinates inside the tree are int64_t, so levels stop short of that
+	static constexpr int MaxLevel = 62;
+
+	Quadtree( );
+
+	// Intern an 8x8 leaf, cell (x, y) at bit y * 8 + x
+	uint32_t Leaf( uint64_t bits );
+	// Intern a node of side 2^level from its quarters, each of side 2^(level - 1)
+	uint32_t Node( int level, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se );
+
+	// Build from a width x height block of 0/1 cells at the tree's top-left
+	void Build( const Cell* cells, int width, int height );
+	void Clear( );
+
+	uint32_t Root = 0;
+	int RootLevel = LeafLevel;
+
+	int Level( uint32_t node ) const;
+	const uint32_t* Children( uint32_t node ) const;
+	uint64_t Bits( uint32_t node ) const;
+	uint64_t Population( uint32_t node ) const;
+	size_t NodeCount( ) const;
+
+	// Smallest rectangle holding every live cell, in tree coordinates. False
+	// if the tree is empty.
+	bool Bounds( int64_t& x, int64_t& y, int64_t& width, int64_t& height );
+
+	// Copy the width x height window with top-left (x, y), in tree
+	// coordinates, into out. Only subtrees overlapping the window are visited.
+	void Materialize( int64_t x, int64_t y, int width, int height, Pattern& out ) const;
+
+private:
+	struct NodeData {
+		int Level;
+		uint32_t Children[4];			// nw, ne, sw, se; unused by leaves
+		uint64_t Bits;					// Leaves only
+		uint64_t Population;
+	};
+	struct NodeKey {
+		int Level;
+		uint32_t Children[4];
+		uint64_t Bits;
+		bool operator==( const NodeKey& other ) const;
+	};
+	struct NodeKeyHash {
+		size_t operator()( const NodeKey& key ) const;
+	};
+	struct NodeBounds {
+		int64_t MinX, MinY, MaxX, MaxY;
+	};
+
+	uint32_t Intern( const NodeKey& key, uint64_t population );
+	const NodeBounds& BoundsOf( uint32_t node );
+	void MaterializeNode( uint32_t node, int64_t nodeX, int64_t nodeY, int64_t x, int64_t y, Pattern& out ) const;
+
+	std::vector<NodeData> nodes;
+	std::unordered_map<NodeKey, uint32_t, NodeKeyHash> index;
+	std::vector<NodeBounds> bounds;		// Filled on demand, alongside nodes
+	std::vector<bool> boundsKnown;
+};
+
+// Golly macrocell (.mc) files, two-state only. The rule and generation come
+// from the #R and #G lines when present.
+struct MacrocellFile {
+	Quadtree Tree;
+	bool HasRule = false;
+	char BirthRule[9]{};
+	char SurviveRule[9]{};
+	uint64_t Generation = 0;
+};
+
+bool ReadMacrocell( const std::string& path, MacrocellFile& out, std::string& error );
+
+// Write a tree; shared subtrees are written once and referred to by number
+bool WriteMacrocell( const std::string& path, const Quadtree& tree, const Rules& rules, uint64_t generation, std::string& error );
\ No newline at end of file
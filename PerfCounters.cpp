@@ -0,0 +1,174 @@
+// PerfCounters.cpp
+
+#include "PerfCounters.h"
+
+#include <cstdio>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* CounterNames[PerfCounterCount] = { "cycles", "instructions", "L1 misses", "LLC misses", "branch misses" };
+
+void PerfSample::Add( const PerfSample& other ) {
+	for ( int i = 0; i < PerfCounterCount; i++ ) {
+		Values[i] += other.Values[i];
+		Available[i] = Available[i] || other.Available[i];
+	}
+	Cells += other.Cells;
+}
+
+double PerfSample::IPC( ) const {
+	if ( !Available[PerfCycles] || !Available[PerfInstructions] || Values[PerfCycles] == 0 )
+		return 0;
+	return (double)Values[PerfInstructions] / Values[PerfCycles];
+}
+
+double PerfSample::PerCell( PerfCounter counter ) const {
+	if ( !Available[counter] || Cells == 0 )
+		return 0;
+	return (double)Values[counter] / Cells;
+}
+
+std::string PerfSample::Summary( ) const {
+	char text[256];
+	int length = 0;
+	if ( Available[PerfCycles] && Available[PerfInstructions] )
+		length += snprintf( text + length, sizeof( text ) - length, "IPC %.2f", IPC( ) );
+	const PerfCounter perCell[] = { PerfL1Misses, PerfLLCMisses, PerfBranchMisses };
+	for ( PerfCounter counter : perCell ) {
+		if ( !Available[counter] )
+			continue;
+		length += snprintf( text + length, sizeof( text ) - length, "%s%s %.4f/cell",
+			length ? ", " : "", CounterNames[counter], PerCell( counter ) );
+	}
+	return length ? std::string( text ) : std::string( "no counters" );
+}
+
+PerfCounters::~PerfCounters( ) {
+	Close( );
+}
+
+bool PerfCounters::IsOpen( ) {
+	return opened;
+}
+
+bool PerfCounters::IsAvailable( ) {
+	for ( int fd : fds ) {
+		if ( fd >= 0 )
+			return true;
+	}
+	return false;
+}
+
+const std::string& PerfCounters::GetError( ) {
+	return error;
+}
+
+#ifdef __linux__
+
+bool PerfCounters::Open( ) {
+	if ( opened )
+		return IsAvailable( );
+	error.clear( );
+
+	const uint64_t cacheReadMiss = ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+	const uint32_t types[PerfCounterCount] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+	const uint64_t configs[PerfCounterCount] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | cacheReadMiss,
+		PERF_COUNT_HW_CACHE_LL | cacheReadMiss,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	// Counters are opened one by one rather than as a group: inherited counters
+	// can't be read as a group, and a CPU missing one event shouldn't lose the rest.
+	for ( int i = 0; i < PerfCounterCount; i++ ) {
+		perf_event_attr attr;
+		memset( &attr, 0, sizeof( attr ) );
+		attr.size = sizeof( attr );
+		attr.type = types[i];
+		attr.config = configs[i];
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		fds[i] = (int)syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+		if ( fds[i] < 0 ) {
+			if ( !error.empty( ) )
+				error += "; ";
+			error += std::string( CounterNames[i] ) + ": " + strerror( errno );
+		}
+	}
+	if ( !IsAvailable( ) && errno == EACCES )
+		error += " (check /proc/sys/kernel/perf_event_paranoid)";
+	opened.store( true, std::memory_order_release );
+	return IsAvailable( );
+}
+
+void PerfCounters::Close( ) {
+	for ( int& fd : fds ) {
+		if ( fd >= 0 )
+			close( fd );
+		fd = -1;
+	}
+	opened = false;
+}
+
+void PerfCounters::Start( ) {
+	for ( int fd : fds ) {
+		if ( fd < 0 )
+			continue;
+		ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+		ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+	}
+}
+
+PerfSample PerfCounters::Stop( uint64_t cells ) {
+	PerfSample sample;
+	sample.Cells = cells;
+	for ( int i = 0; i < PerfCounterCount; i++ ) {
+		if ( fds[i] < 0 )
+			continue;
+		ioctl( fds[i], PERF_EVENT_IOC_DISABLE, 0 );
+		uint64_t data[3];
+		if ( read( fds[i], data, sizeof( data ) ) != sizeof( data ) )
+			continue;
+		// Scale up if the kernel had to multiplex the counter
+		double value = (double)data[0];
+		if ( data[2] > 0 && data[2] < data[1] )
+			value *= (double)data[1] / data[2];
+		sample.Values[i] = (uint64_t)value;
+		sample.Available[i] = data[2] > 0;
+	}
+	return sample;
+}
+
+#else
+
+bool PerfCounters::Open( ) {
+	error = "Hardware counters are only supported on Linux";
+	opened.store( true, std::memory_order_release );
+	return false;
+}
+
+void PerfCounters::Close( ) {
+	opened = false;
+}
+
+void PerfCounters::Start( ) { }
+
+PerfSample PerfCounters::Stop( uint64_t cells ) {
+	PerfSample sample;
+	sample.Cells = cells;
+	return sample;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+// PerfCounters.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+enum PerfCounter {
+	PerfCycles,
+	PerfInstructions,
+	PerfL1Misses,
+	PerfLLCMisses,
+	PerfBranchMisses,
+	PerfCounterCount
+};
+
+struct PerfSample {
+	uint64_t Values[PerfCounterCount]{};
+	bool Available[PerfCounterCount]{};
+	uint64_t Cells = 0;		// Cells processed while counting, for per-cell ratios
+
+	void Add( const PerfSample& other );
+	double IPC( ) const;
+	double PerCell( PerfCounter counter ) const;
+	// One line summary such as "IPC 2.31, L1 0.012/cell, ..."
+	std::string Summary( ) const;
+};
+
+// Hardware performance counters for the calling thread and the threads it spawns.
+// Uses perf_event_open on Linux; elsewhere, or when the kernel refuses, every
+// counter simply reports as unavailable.
+class PerfCounters {
+public:
+	PerfCounters( ) = default;
+	~PerfCounters( );
+	PerfCounters( const PerfCounters& ) = delete;
+	PerfCounters& operator=( const PerfCounters& ) = delete;
+
+	// Open the counters. Threads spawned after this are counted too. Once IsOpen
+	// returns true, IsAvailable and GetError may be called from any thread.
+	bool Open( );
+	void Close( );
+	bool IsOpen( );
+
+	// Whether at least one counter could be opened
+	bool IsAvailable( );
+
+	// Why counters are missing, empty if all opened
+	const std::string& GetError( );
+
+	void Start( );
+	PerfSample Stop( uint64_t cells );
+
+private:
+	int fds[PerfCounterCount] = { -1, -1, -1, -1, -1 };
+	std::atomic<bool> opened{ false };
+	std::string error;
+};
\ No newline at end of file
@@ -0,0 +1,142 @@
+// PixelExpand.cpp
+
+#include "PixelExpand.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define PIXEL_EXPAND_SSSE3
+#elif defined(__SSE2__) || defined(_M_X64)
+// Every x86-64 build has SSE2, so default builds get a vector path too
+#include <emmintrin.h>
+#define PIXEL_EXPAND_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define PIXEL_EXPAND_NEON
+#endif
+
+// Below this many cells a frame isn't worth spreading across threads
+static const size_t ThreadedExpandCells = 1 << 18;
+
+void ExpandCellsReference( const Cell* cells, size_t count, const Palette& palette, uint32_t* out ) {
+	for ( size_t i = 0; i < count; i++ )
+		out[i] = palette.Colors[cells[i]];
+}
+
+void ExpandCells( const Cell* cells, size_t count, const Palette& palette, uint32_t* out ) {
+	size_t i = 0;
+#if defined(PIXEL_EXPAND_SSE2)
+	if ( palette.Size <= 16 ) {
+		// No byte shuffle before SSSE3: each palette entry is matched against 16
+		// cells at once, and the byte masks widened to pick its color into each pixel
+		__m128i colors[16];
+		for ( int c = 0; c < palette.Size; c++ )
+			colors[c] = _mm_set1_epi32( (int)palette.Colors[c] );
+		for ( ; i + 16 <= count; i += 16 ) {
+			const __m128i index = _mm_loadu_si128( (const __m128i*)( cells + i ) );
+			__m128i pixels[4] = { _mm_setzero_si128( ), _mm_setzero_si128( ), _mm_setzero_si128( ), _mm_setzero_si128( ) };
+			for ( int c = 0; c < palette.Size; c++ ) {
+				const __m128i match = _mm_cmpeq_epi8( index, _mm_set1_epi8( (char)c ) );
+				const __m128i low = _mm_unpacklo_epi8( match, match );
+				const __m128i high = _mm_unpackhi_epi8( match, match );
+				pixels[0] = _mm_or_si128( pixels[0], _mm_and_si128( _mm_unpacklo_epi16( low, low ), colors[c] ) );
+				pixels[1] = _mm_or_si128( pixels[1], _mm_and_si128( _mm_unpackhi_epi16( low, low ), colors[c] ) );
+				pixels[2] = _mm_or_si128( pixels[2], _mm_and_si128( _mm_unpacklo_epi16( high, high ), colors[c] ) );
+				pixels[3] = _mm_or_si128( pixels[3], _mm_and_si128( _mm_unpackhi_epi16( high, high ), colors[c] ) );
+			}
+			__m128i* dest = (__m128i*)( out + i );
+			for ( int quarter = 0; quarter < 4; quarter++ )
+				_mm_storeu_si128( dest + quarter, pixels[quarter] );
+		}
+	}
+#endif
+#if defined(PIXEL_EXPAND_SSSE3) || defined(PIXEL_EXPAND_NEON)
+	if ( palette.Size <= 16 ) {
+		// Split the palette into one 16-entry table per channel so each channel
+		// of 16 pixels is a single byte shuffle indexed by the cells
+		alignas( 16 ) unsigned char planes[4][16]{};
+		for ( int c = 0; c < palette.Size; c++ ) {
+			unsigned char bytes[4];
+			memcpy( bytes, &palette.Colors[c], 4 );
+			for ( int channel = 0; channel < 4; channel++ )
+				planes[channel][c] = bytes[channel];
+		}
+#if defined(PIXEL_EXPAND_SSSE3)
+		const __m128i r = _mm_load_si128( (const __m128i*)planes[0] );
+		const __m128i g = _mm_load_si128( (const __m128i*)planes[1] );
+		const __m128i b = _mm_load_si128( (const __m128i*)planes[2] );
+		const __m128i a = _mm_load_si128( (const __m128i*)planes[3] );
+		for ( ; i + 16 <= count; i += 16 ) {
+			__m128i index = _mm_loadu_si128( (const __m128i*)( cells + i ) );
+			__m128i rs = _mm_shuffle_epi8( r, index );
+			__m128i gs = _mm_shuffle_epi8( g, index );
+			__m128i bs = _mm_shuffle_epi8( b, index );
+			__m128i as = _mm_shuffle_epi8( a, index );
+			__m128i rgLow = _mm_unpacklo_epi8( rs, gs );
+			__m128i rgHigh = _mm_unpackhi_epi8( rs, gs );
+			__m128i baLow = _mm_unpacklo_epi8( bs, as );
+			__m128i baHigh = _mm_unpackhi_epi8( bs, as );
+			__m128i* dest = (__m128i*)( out + i );
+			_mm_storeu_si128( dest + 0, _mm_unpacklo_epi16( rgLow, baLow ) );
+			_mm_storeu_si128( dest + 1, _mm_unpackhi_epi16( rgLow, baLow ) );
+			_mm_storeu_si128( dest + 2, _mm_unpacklo_epi16( rgHigh, baHigh ) );
+			_mm_storeu_si128( dest + 3, _mm_unpackhi_epi16( rgHigh, baHigh ) );
+		}
+#else
+		const uint8x16_t r = vld1q_u8( planes[0] );
+		const uint8x16_t g = vld1q_u8( planes[1] );
+		const uint8x16_t b = vld1q_u8( planes[2] );
+		const uint8x16_t a = vld1q_u8( planes[3] );
+		for ( ; i + 16 <= count; i += 16 ) {
+			uint8x16_t index = vld1q_u8( cells + i );
+			uint8x16x4_t pixels;
+			pixels.val[0] = vqtbl1q_u8( r, index );
+			pixels.val[1] = vqtbl1q_u8( g, index );
+			pixels.val[2] = vqtbl1q_u8( b, index );
+			pixels.val[3] = vqtbl1q_u8( a, index );
+			vst4q_u8( (uint8_t*)( out + i ), pixels );
+		}
+#endif
+	}
+#endif
+	ExpandCellsReference( cells + i, count - i, palette, out + i );
+}
+
+void ExpandRows( const Cell* cells, int width, int startRow, int endRow, int scale, const Palette& palette, uint32_t* out ) {
+	const size_t outWidth = (size_t)width * scale;
+	std::vector<uint32_t> row( scale > 1 ? width : 0 );
+	for ( int y = startRow; y < endRow; y++ ) {
+		const Cell* source = cells + (size_t)y * width;
+		uint32_t* dest = out + (size_t)y * scale * outWidth;
+		if ( scale == 1 ) {
+			ExpandCells( source, width, palette, dest );
+			continue;
+		}
+		ExpandCells( source, width, palette, row.data( ) );
+		for ( int x = 0; x < width; x++ )
+			std::fill_n( dest + (size_t)x * scale, scale, row[x] );
+		for ( int copy = 1; copy < scale; copy++ )
+			memcpy( dest + copy * outWidth, dest, outWidth * sizeof( uint32_t ) );
+	}
+}
+
+void ExpandGrid( const Cell* cells, int width, int height, int scale, const Palette& palette, uint32_t* out ) {
+	const size_t pixels = (size_t)width * height * scale * scale;
+	int numThreads = (int)std::min<size_t>( std::thread::hardware_concurrency( ), pixels / ThreadedExpandCells );
+	numThreads = std::min( numThreads, height );
+	if ( numThreads <= 1 ) {
+		ExpandRows( cells, width, 0, height, scale, palette, out );
+		return;
+	}
+	const int chunkSize = height / numThreads;
+	std::vector<std::thread> threads( numThreads );
+	for ( int i = 0; i < numThreads; i++ ) {
+		int startRow = i * chunkSize;
+		int endRow = ( i == numThreads - 1 ) ? height : ( i + 1 ) * chunkSize;
+		threads[i] = std::thread( ExpandRows, cells, width, startRow, endRow, scale, std::cref( palette ), out );
+	}
+	for ( auto& thread : threads ) thread.join( );
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+// PixelExpand.h
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Grid.h"
+
+// Up to 256 colors indexed by cell value, each packed in memory order (R, G, B, A bytes)
+struct Palette {
+	uint32_t Colors[256]{};
+	int Size = 2;						// Entries in use; every cell value must be below this
+};
+
+// Pack a color so its bytes land in memory as R, G, B, A
+inline uint32_t PackColor( unsigned char r, unsigned char g, unsigned char b, unsigned char a ) {
+	uint32_t packed;
+	const unsigned char bytes[4] = { r, g, b, a };
+	memcpy( &packed, bytes, 4 );
+	return packed;
+}
+
+// One palette lookup per cell. Kept as the reference the vector paths are checked against.
+void ExpandCellsReference( const Cell* cells, size_t count, const Palette& palette, uint32_t* out );
+
+// Palette lookup 16 cells at a time with SSSE3 or NEON table shuffles, or SSE2
+// compares on x86-64 builds without SSSE3, when the palette has at most 16
+// entries; otherwise falls back to the reference loop.
+void ExpandCells( const Cell* cells, size_t count, const Palette& palette, uint32_t* out );
+
+// Expand rows startRow to endRow - 1 of a width-wide block of cells on the
+// calling thread, writing them where ExpandGrid would
+void ExpandRows( const Cell* cells, int width, int startRow, int endRow, int scale, const Palette& palette, uint32_t* out );
+
+// Expand a width x height block of cells into pixels, each cell becoming a
+// scale x scale square, with the rows split across threads for large grids.
+// out must hold width * scale * height * scale pixels.
+void ExpandGrid( const Cell* cells, int width, int height, int scale, const Palette& palette, uint32_t* out );
\ No newline at end of file
@@ -0,0 +1,203 @@
+// Profiler.cpp
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+	const size_t RingCapacity = 1 << 16;
+
+	// A slot is written under a sequence number, odd while the owner writes
+	// it and 2 * (index + 1) once event index is complete, so the exporter
+	// can copy slots while they are being overwritten and drop the torn ones.
+	struct ZoneEvent {
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> start{ 0 };
+		std::atomic<uint64_t> end{ 0 };
+	};
+
+	// Single-producer ring buffer. Only the thread that holds it writes; the
+	// exporter reads whatever has been published through head.
+	struct ThreadBuffer {
+		std::unique_ptr<ZoneEvent[]> events{ new ZoneEvent[RingCapacity] };
+		std::atomic<uint64_t> head{ 0 };
+		std::atomic<uint64_t> first{ 0 };	// Events before this were dropped by Reset
+		std::string name;
+		int tid = 0;
+		bool held = false;					// A live thread writes to it
+		bool lane = false;					// Bound with SetThreadLane rather than anonymous
+	};
+
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	// Lanes by name and index; a lane gets copies while concurrent owners
+	// (ticks on several grids) use it at once
+	std::map<std::pair<std::string, int>, std::vector<ThreadBuffer*>> lanes;
+	// Anonymous buffers of threads that have exited, reused before allocating more
+	std::vector<ThreadBuffer*> freeBuffers;
+
+	const auto epoch = std::chrono::steady_clock::now( );
+
+	// Gives the thread's buffer back when the thread exits
+	struct HeldBuffer {
+		ThreadBuffer* buffer = nullptr;
+		~HeldBuffer( );
+	};
+
+	thread_local HeldBuffer currentBuffer;
+
+	ThreadBuffer* NewBuffer( const std::string& name ) {
+		// Caller holds registryMutex
+		buffers.push_back( std::make_unique<ThreadBuffer>( ) );
+		ThreadBuffer* buffer = buffers.back( ).get( );
+		buffer->tid = (int)buffers.size( );
+		buffer->name = name.empty( ) ? "Thread " + std::to_string( buffer->tid ) : name;
+		return buffer;
+	}
+
+	void Release( ThreadBuffer* buffer ) {
+		// Caller holds registryMutex
+		buffer->held = false;
+		if ( !buffer->lane )
+			freeBuffers.push_back( buffer );
+	}
+
+	HeldBuffer::~HeldBuffer( ) {
+		if ( !buffer )
+			return;
+		std::lock_guard<std::mutex> lock( registryMutex );
+		Release( buffer );
+	}
+
+	ThreadBuffer* GetBuffer( ) {
+		if ( !currentBuffer.buffer ) {
+			std::lock_guard<std::mutex> lock( registryMutex );
+			ThreadBuffer* buffer;
+			if ( !freeBuffers.empty( ) ) {
+				buffer = freeBuffers.back( );
+				freeBuffers.pop_back( );
+			} else {
+				buffer = NewBuffer( "" );
+			}
+			buffer->held = true;
+			currentBuffer.buffer = buffer;
+		}
+		return currentBuffer.buffer;
+	}
+
+	void WriteEscaped( FILE* file, const std::string& text ) {
+		for ( char c : text ) {
+			if ( c == '"' || c == '\\' )
+				fputc( '\\', file );
+			if ( (unsigned char)c >= 0x20 )
+				fputc( c, file );
+		}
+	}
+}
+
+std::atomic<bool> Profiler::capturing{ false };
+
+void Profiler::SetCapturing( bool value ) {
+	capturing.store( value, std::memory_order_relaxed );
+}
+
+bool Profiler::IsCapturing( ) {
+	return capturing.load( std::memory_order_relaxed );
+}
+
+void Profiler::SetThreadName( const char* name ) {
+	ThreadBuffer* buffer = GetBuffer( );
+	std::lock_guard<std::mutex> lock( registryMutex );
+	buffer->name = name;
+}
+
+void Profiler::SetThreadLane( const char* name, int index ) {
+	std::lock_guard<std::mutex> lock( registryMutex );
+	if ( currentBuffer.buffer )
+		Release( currentBuffer.buffer );
+	std::vector<ThreadBuffer*>& copies = lanes[std::make_pair( std::string( name ), index )];
+	ThreadBuffer* buffer = nullptr;
+	for ( ThreadBuffer* copy : copies ) {
+		if ( !copy->held ) {
+			buffer = copy;
+			break;
+		}
+	}
+	if ( !buffer ) {
+		std::string laneName = std::string( name ) + " " + std::to_string( index );
+		if ( !copies.empty( ) )
+			laneName += " (" + std::to_string( copies.size( ) + 1 ) + ")";
+		buffer = NewBuffer( laneName );
+		buffer->lane = true;
+		copies.push_back( buffer );
+	}
+	buffer->held = true;
+	currentBuffer.buffer = buffer;
+}
+
+void Profiler::Reset( ) {
+	// Owners keep writing at head, so the start is moved up rather than head rewound
+	std::lock_guard<std::mutex> lock( registryMutex );
+	for ( auto& buffer : buffers )
+		buffer->first.store( buffer->head.load( std::memory_order_acquire ), std::memory_order_relaxed );
+}
+
+uint64_t Profiler::Now( ) {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now( ) - epoch ).count( );
+}
+
+void Profiler::Record( const char* name, uint64_t start, uint64_t end ) {
+	ThreadBuffer* buffer = GetBuffer( );
+	uint64_t head = buffer->head.load( std::memory_order_relaxed );
+	ZoneEvent& event = buffer->events[head % RingCapacity];
+	event.sequence.store( 2 * head + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	event.name.store( name, std::memory_order_relaxed );
+	event.start.store( start, std::memory_order_relaxed );
+	event.end.store( end, std::memory_order_relaxed );
+	event.sequence.store( 2 * head + 2, std::memory_order_release );
+	buffer->head.store( head + 1, std::memory_order_release );
+}
+
+bool Profiler::ExportChromeTrace( const std::string& path ) {
+	FILE* file = fopen( path.c_str( ), "w" );
+	if ( !file )
+		return false;
+	std::lock_guard<std::mutex> lock( registryMutex );
+	fputs( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file );
+	bool first = true;
+	for ( auto& buffer : buffers ) {
+		fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", first ? "" : ",\n", buffer->tid );
+		WriteEscaped( file, buffer->name );
+		fputs( "\"}}", file );
+		first = false;
+
+		uint64_t head = buffer->head.load( std::memory_order_acquire );
+		uint64_t begin = head > RingCapacity ? head - RingCapacity : 0;
+		begin = std::max( begin, buffer->first.load( std::memory_order_relaxed ) );
+		for ( uint64_t i = begin; i < head; i++ ) {
+			// Slots the owner is rewriting, or has moved past, fail the sequence check
+			const ZoneEvent& slot = buffer->events[i % RingCapacity];
+			uint64_t sequence = slot.sequence.load( std::memory_order_acquire );
+			const char* name = slot.name.load( std::memory_order_relaxed );
+			uint64_t start = slot.start.load( std::memory_order_relaxed );
+			uint64_t end = slot.end.load( std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_acquire );
+			if ( sequence != 2 * i + 2 || slot.sequence.load( std::memory_order_relaxed ) != sequence )
+				continue;
+			fputs( ",\n{\"name\":\"", file );
+			WriteEscaped( file, name );
+			fprintf( file, "\",\"cat\":\"life23\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->tid, start / 1000.0, ( end - start ) / 1000.0 );
+		}
+	}
+	fputs( "\n]}\n", file );
+	return fclose( file ) == 0;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+// Profiler.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Concatenates tokens after expanding them, so __LINE__ can be used in identifiers.
+#define PROFILE_CONCAT_INNER(a,b) a##b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT_INNER(a,b)
+
+#ifdef LIFE23_DISABLE_PROFILING
+#define PROFILE_ZONE(name)
+#else
+// Records the enclosing scope as a named zone while capture is enabled.
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)( name )
+#endif
+
+class Profiler {
+public:
+	// Start or stop recording zones
+	static void SetCapturing( bool capturing );
+
+	static bool IsCapturing( );
+
+	// Name the calling thread's lane in exported traces
+	static void SetThreadName( const char* name );
+
+	// Bind the calling thread to a named lane, e.g. worker 3. Threads that are
+	// recreated every tick keep writing to the same lane instead of piling up new ones.
+	static void SetThreadLane( const char* name, int index );
+
+	// Forget all recorded zones
+	static void Reset( );
+
+	// Write every recorded zone as Chrome trace JSON (viewable in Perfetto)
+	static bool ExportChromeTrace( const std::string& path );
+
+	// Nanoseconds since the profiler's epoch
+	static uint64_t Now( );
+
+	// Append a finished zone to the calling thread's ring buffer
+	static void Record( const char* name, uint64_t start, uint64_t end );
+
+	static std::atomic<bool> capturing;
+};
+
+class ProfileZone {
+public:
+	ProfileZone( const char* name ) {
+		if ( Profiler::capturing.load( std::memory_order_relaxed ) ) {
+			this->name = name;
+			start = Profiler::Now( );
+		}
+	}
+
+	~ProfileZone( ) {
+		if ( name )
+			Profiler::Record( name, start, Profiler::Now( ) );
+	}
+
+	ProfileZone( const ProfileZone& ) = delete;
+	ProfileZone& operator=( const ProfileZone& ) = delete;
+
+private:
+	const char* name = nullptr;
+	uint64_t start = 0;
+};
\ No newline at end of file
@@ -0,0 +1,152 @@
+// ReferenceEngine.cpp
+
+#include "ReferenceEngine.h"
+
+#include "Profiler.h"
+
+static EngineRegistration registration( DefaultEngineName,
+	"The grid's own tick, split across cores when multithreading is on",
+	[]( ) -> std::unique_ptr<Engine> { return std::make_unique<ReferenceEngine>( ); } );
+
+void ReferenceEngine::Attach( Grid& target ) {
+	grid = &target;
+}
+
+void ReferenceEngine::Detach( ) {
+	grid = nullptr;
+}
+
+void ReferenceEngine::Step( int generations, bool multithreaded ) {
+	for ( int i = 0; i < generations; i++ ) {
+		if ( multithreaded )
+			grid->TickWithMultithreading( );
+		else
+			grid->Tick( );
+	}
+}
+
+int ReferenceEngine::GetWidth( ) {
+	return grid->GetWidth( );
+}
+
+int ReferenceEngine::GetHeight( ) {
+	return grid->GetHeight( );
+}
+
+uint64_t ReferenceEngine::GetGeneration( ) {
+	return grid->Generation;
+}
+
+uint32_t ReferenceEngine::GetSeed( ) {
+	return grid->Seed;
+}
+
+void ReferenceEngine::ReadRect( int x, int y, int width, int height, Pattern& out ) {
+	grid->CopyBlock( x, y, width, height, out );
+}
+
+void ReferenceEngine::WriteSpan( int y, int x0, int x1, Cell value ) {
+	grid->FillSpan( y, x0, x1, value );
+}
+
+void ReferenceEngine::Paste( int x, int y, const Pattern& block ) {
+	grid->PasteBlock( x, y, block );
+}
+
+void ReferenceEngine::FloodFill( int x, int y, Cell value ) {
+	grid->FloodFill( x, y, value );
+}
+
+void ReferenceEngine::Load( int width, int height, const std::vector<Cell>& cells, uint64_t generation, uint32_t seed ) {
+	grid->Load( width, height, cells );
+	grid->Generation = generation;
+	grid->Seed = seed;
+}
+
+void ReferenceEngine::Resize( int width, int height ) {
+	grid->Resize( width, height );
+}
+
+void ReferenceEngine::Clear( ) {
+	grid->Clear( );
+}
+
+void ReferenceEngine::Randomize( float percent, uint32_t seed ) {
+	grid->Randomize( percent, seed );
+}
+
+GridCheckpoint ReferenceEngine::Checkpoint( ) {
+	return grid->Checkpoint( );
+}
+
+void ReferenceEngine::Restore( const GridCheckpoint& checkpoint ) {
+	grid->Restore( checkpoint );
+}
+
+uint64_t ReferenceEngine::GetStamp( ) {
+	return grid->GetStamp( );
+}
+
+uint64_t ReferenceEngine::RowStamp( int y ) {
+	return grid->RowStamp( y );
+}
+
+void ReferenceEngine::AdvanceStamp( ) {
+	grid->AdvanceStamp( );
+}
+
+void ReferenceEngine::SetRules( const Rules& rules ) {
+	grid->SetRules( rules );
+}
+
+Rules ReferenceEngine::GetRules( ) {
+	return grid->GetRules( );
+}
+
+void ReferenceEngine::TrackAges( bool track ) {
+	grid->TrackAges( track );
+}
+
+bool ReferenceEngine::TracksAges( ) {
+	return grid->TracksAges( );
+}
+
+const uint8_t* ReferenceEngine::AgeRow( int y ) {
+	return grid->AgeRow( y );
+}
+
+void ReferenceEngine::TrackHeat( bool track ) {
+	grid->TrackHeat( track );
+}
+
+bool ReferenceEngine::TracksHeat( ) {
+	return grid->TracksHeat( );
+}
+
+void ReferenceEngine::SetHeatDecay( int decayShift ) {
+	grid->SetHeatDecay( decayShift );
+}
+
+const uint8_t* ReferenceEngine::HeatRow( int y ) {
+	return grid->HeatRow( y );
+}
+
+uint64_t ReferenceEngine::Population( ) {
+	PROFILE_ZONE( "ReferenceEngine::Population" );
+	uint64_t population = 0;
+	for ( int y = 0; y < grid->GetHeight( ); y++ ) {
+		const Cell* row = grid->Row( y );
+		for ( int x = 0; x < grid->GetWidth( ); x++ )
+			population += row[x];
+	}
+	return population;
+}
+
+uint64_t ReferenceEngine::Hash( ) {
+	PROFILE_ZONE( "ReferenceEngine::Hash" );
+	const uint32_t size[2] = { (uint32_t)grid->GetWidth( ), (uint32_t)grid->GetHeight( ) };
+	uint64_t hash = HashBytes( HashBasis, size, sizeof( size ) );
+	for ( int y = 0; y < grid->GetHeight( ); y++ )
+		hash = HashBytes( hash, grid->Row( y ), grid->GetWidth( ) );
+	return hash;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+// ReferenceEngine.h
+
+#pragma once
+
+#include "Engine.h"
+
+// The grid's own tick, on one thread or split by bands across all cores.
+// Works on the grid in place, so it has nothing to convert or keep in step.
+class ReferenceEngine : public Engine {
+public:
+	void Attach( Grid& grid ) override;
+	void Detach( ) override;
+	void Step( int generations, bool multithreaded ) override;
+	int GetWidth( ) override;
+	int GetHeight( ) override;
+	uint64_t GetGeneration( ) override;
+	uint32_t GetSeed( ) override;
+	void ReadRect( int x, int y, int width, int height, Pattern& out ) override;
+	void WriteSpan( int y, int x0, int x1, Cell value ) override;
+	void Paste( int x, int y, const Pattern& block ) override;
+	void FloodFill( int x, int y, Cell value ) override;
+	void Load( int width, int height, const std::vector<Cell>& cells, uint64_t generation, uint32_t seed ) override;
+	void Resize( int width, int height ) override;
+	void Clear( ) override;
+	void Randomize( float percent, uint32_t seed ) override;
+	GridCheckpoint Checkpoint( ) override;
+	void Restore( const GridCheckpoint& checkpoint ) override;
+	uint64_t GetStamp( ) override;
+	uint64_t RowStamp( int y ) override;
+	void AdvanceStamp( ) override;
+	void SetRules( const Rules& rules ) override;
+	Rules GetRules( ) override;
+	void TrackAges( bool track ) override;
+	bool TracksAges( ) override;
+	const uint8_t* AgeRow( int y ) override;
+	void TrackHeat( bool track ) override;
+	bool TracksHeat( ) override;
+	void SetHeatDecay( int decayShift ) override;
+	const uint8_t* HeatRow( int y ) override;
+	uint64_t Population( ) override;
+	uint64_t Hash( ) override;
+
+private:
+	Grid* grid = nullptr;
+};
\ No newline at end of file
@@ -0,0 +1,113 @@
+// Region.cpp
+
+#include "Region.h"
+
+#include <algorithm>
+#include <cstring>
+
+void CopyBlock( const Cell* cells, int gridWidth, int gridHeight, bool wrap, int x, int y, int width, int height, Pattern& out ) {
+	std::vector<const Cell*> rows( gridHeight );
+	for ( int row = 0; row < gridHeight; row++ )
+		rows[row] = cells + (size_t)row * gridWidth;
+	CopyBlock( rows.data( ), gridWidth, gridHeight, wrap, x, y, width, height, out );
+}
+
+void CopyBlock( const Cell* const* rows, int gridWidth, int gridHeight, bool wrap, int x, int y, int width, int height, Pattern& out ) {
+	out.Width = width;
+	out.Height = height;
+	out.Cells.assign( (size_t)width * height, 0 );
+	for ( int row = 0; row < height; row++ ) {
+		int sourceY = y + row;
+		if ( wrap )
+			sourceY = MOD_POSITIVE( sourceY, gridHeight );
+		else if ( sourceY < 0 || sourceY >= gridHeight )
+			continue;
+		const Cell* source = rows[sourceY];
+		Cell* target = out.Cells.data( ) + (size_t)row * width;
+		// Copy the block row in pieces that each stay within one copy of the grid row
+		int column = 0;
+		while ( column < width ) {
+			int sourceX = x + column;
+			int length;
+			if ( wrap ) {
+				sourceX = MOD_POSITIVE( sourceX, gridWidth );
+				length = std::min( width - column, gridWidth - sourceX );
+			} else if ( sourceX < 0 ) {
+				column = -x;
+				continue;
+			} else if ( sourceX >= gridWidth ) {
+				break;
+			} else {
+				length = std::min( width - column, gridWidth - sourceX );
+			}
+			memcpy( target + column, source + sourceX, length );
+			column += length;
+		}
+	}
+}
+
+Pattern RotateClockwise( const Pattern& pattern ) {
+	Pattern rotated;
+	rotated.Width = pattern.Height;
+	rotated.Height = pattern.Width;
+	rotated.Cells.resize( pattern.Cells.size( ) );
+	// Walk in tiles so both the rows read and the columns written stay in cache
+	const int tile = 64;
+	for ( int y0 = 0; y0 < pattern.Height; y0 += tile ) {
+		for ( int x0 = 0; x0 < pattern.Width; x0 += tile ) {
+			const int y1 = std::min( y0 + tile, pattern.Height );
+			const int x1 = std::min( x0 + tile, pattern.Width );
+			for ( int y = y0; y < y1; y++ ) {
+				const Cell* row = pattern.Cells.data( ) + (size_t)y * pattern.Width;
+				for ( int x = x0; x < x1; x++ )
+					rotated.Cells[(size_t)x * rotated.Width + ( pattern.Height - 1 - y )] = row[x];
+			}
+		}
+	}
+	return rotated;
+}
+
+void FlipHorizontal( Pattern& pattern ) {
+	for ( int y = 0; y < pattern.Height; y++ ) {
+		Cell* row = pattern.Cells.data( ) + (size_t)y * pattern.Width;
+		std::reverse( row, row + pattern.Width );
+	}
+}
+
+void FlipVertical( Pattern& pattern ) {
+	for ( int y = 0; y < pattern.Height / 2; y++ ) {
+		Cell* top = pattern.Cells.data( ) + (size_t)y * pattern.Width;
+		Cell* bottom = pattern.Cells.data( ) + (size_t)( pattern.Height - 1 - y ) * pattern.Width;
+		std::swap_ranges( top, top + pattern.Width, bottom );
+	}
+}
+
+static const struct ByteCellTable {
+	uint64_t Cells[256];
+
+	ByteCellTable( ) {
+		for ( int byte = 0; byte < 256; byte++ ) {
+			Cell cells[8];
+			for ( int bit = 0; bit < 8; bit++ )
+				cells[bit] = ( byte >> bit ) & 1;
+			memcpy( &Cells[byte], cells, 8 );
+		}
+	}
+} byteCellTable;
+
+const uint64_t* const ByteCells = byteCellTable.Cells;
+
+void PackBits( const Cell* cells, int count, uint64_t* words ) {
+	for ( int start = 0; start < count; start += 64 ) {
+		const int length = std::min( 64, count - start );
+		uint64_t word = 0;
+		for ( int i = 0; i < length; i += 8 )
+			word |= (uint64_t)PackByte( cells + start + i, std::min( 8, length - i ) ) << i;
+		words[start / 64] = word;
+	}
+}
+
+void UnpackBits( const uint64_t* words, int count, Cell* cells ) {
+	for ( int i = 0; i < count; i += 8 )
+		UnpackByte( (uint8_t)( words[i / 64] >> ( i % 64 ) ), cells + i, std::min( 8, count - i ) );
+}
\ No newline at end of file
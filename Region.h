@@ -0,0 +1,63 @@
+// Region.h
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Grid.h"
+
+// A rectangular block of cells, row by row
+struct Pattern {
+	int Width = 0;
+	int Height = 0;
+	std::vector<Cell> Cells;
+};
+
+// Copy the width x height block with top-left cell (x, y) out of a gridWidth x
+// gridHeight array of cells, a row segment at a time. Cells outside the array
+// wrap around if wrap is set and read as dead otherwise.
+void CopyBlock( const Cell* cells, int gridWidth, int gridHeight, bool wrap, int x, int y, int width, int height, Pattern& out );
+
+// As above, for a grid whose rows are not stored one after another
+void CopyBlock( const Cell* const* rows, int gridWidth, int gridHeight, bool wrap, int x, int y, int width, int height, Pattern& out );
+
+// The pattern turned a quarter turn clockwise
+Pattern RotateClockwise( const Pattern& pattern );
+
+// Mirror left to right, or top to bottom
+void FlipHorizontal( Pattern& pattern );
+void FlipVertical( Pattern& pattern );
+
+// Pack count 0/1 cells into bits, cell i at bit i % 64 of words[i / 64]. Bits
+// past count in the last word are 0.
+void PackBits( const Cell* cells, int count, uint64_t* words );
+void UnpackBits( const uint64_t* words, int count, Cell* cells );
+
+// The eight cells of every byte of bits, cell i from bit i, as one word
+extern const uint64_t* const ByteCells;
+
+// Up to eight 0/1 cells as a byte, cell i at bit i. Multiplying eight bytes
+// by the constant gathers them into the top byte.
+inline uint8_t PackByte( const Cell* cells, int count = 8 ) {
+	if ( count == 8 ) {
+		uint64_t bytes;
+		memcpy( &bytes, cells, 8 );
+		return (uint8_t)( ( bytes * 0x0102040810204080ULL ) >> 56 );
+	}
+	uint8_t bits = 0;
+	for ( int i = 0; i < count; i++ )
+		bits |= ( cells[i] & 1 ) << i;
+	return bits;
+}
+
+// The eight cells of a byte of bits, or the first count of them
+inline void UnpackByte( uint8_t bits, Cell* cells, int count = 8 ) {
+	if ( count == 8 ) {
+		memcpy( cells, &ByteCells[bits], 8 );
+		return;
+	}
+	for ( int i = 0; i < count; i++ )
+		cells[i] = ( bits >> i ) & 1;
+}
\ No newline at end of file
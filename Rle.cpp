@@ -0,0 +1,438 @@
+// Rle.cpp
+
+#include "Rle.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Bytes read from disk at a time
+static const size_t BlockBytes = 8 << 20;
+// Least body text, or cells, worth handing to another thread
+static const size_t ThreadedDecodeBytes = 1 << 20;
+static const size_t ThreadedEncodeCells = 1 << 22;
+// The format asks for lines of at most 70 characters
+static const int MaxLineLength = 70;
+// Ten digits of run count and a tag
+static const int MaxTokenLength = 11;
+
+static bool IsTag( char c ) {
+	return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || c == '$' || c == '!' || c == '.';
+}
+
+bool ParseRule( const std::string& text, char birth[9], char survive[9] ) {
+	std::fill( birth, birth + 9, 0 );
+	std::fill( survive, survive + 9, 0 );
+	// Drop a topology suffix such as ":T100,100"
+	std::string rule = text.substr( 0, text.find( ':' ) );
+	bool letters = rule.find_first_of( "BbSs" ) != std::string::npos;
+	char* digits = letters ? nullptr : survive;
+	bool any = false;
+	for ( char c : rule ) {
+		if ( c == 'B' || c == 'b' ) {
+			digits = birth;
+		} else if ( c == 'S' || c == 's' ) {
+			digits = survive;
+		} else if ( c == '/' ) {
+			if ( !letters )
+				digits = birth;
+		} else if ( c >= '0' && c <= '8' && digits ) {
+			digits[c - '0'] = 1;
+			any = true;
+		} else if ( !isspace( (unsigned char)c ) ) {
+			return false;
+		}
+	}
+	return any || letters;
+}
+
+std::string FormatRule( const Rules& rules ) {
+	std::string rule = "B";
+	for ( int i = 0; i < 9; i++ ) {
+		if ( rules.BirthRule[i] )
+			rule += (char)( '0' + i );
+	}
+	rule += "/S";
+	for ( int i = 0; i < 9; i++ ) {
+		if ( rules.SurviveRule[i] )
+			rule += (char)( '0' + i );
+	}
+	return rule;
+}
+
+// Walk RLE body text from cell (x, y), leaving x and y where the text ends.
+// With a pattern, live runs inside it are written; without, only the cursor
+// moves, which is how a chunk's effect is measured before its start is known.
+static void DecodeRuns( const char* text, const char* end, int& x, int& y, Pattern* pattern ) {
+	int count = 0;
+	for ( ; text < end; text++ ) {
+		const char c = *text;
+		if ( c >= '0' && c <= '9' ) {
+			count = count * 10 + ( c - '0' );
+			continue;
+		}
+		if ( !IsTag( c ) )
+			continue;
+		const int run = count ? count : 1;
+		count = 0;
+		if ( c == '$' ) {
+			y += run;
+			x = 0;
+			continue;
+		}
+		if ( c != 'b' && c != '.' && pattern && y < pattern->Height && x < pattern->Width ) {
+			Cell* row = pattern->Cells.data( ) + (size_t)y * pattern->Width;
+			memset( row + x, 1, std::min( run, pattern->Width - x ) );
+		}
+		x += run;
+	}
+}
+
+// Decode body text that ends just after a tag. Big stretches are split into
+// chunks at tag boundaries: every chunk first measures how far it moves the
+// cursor from (0, 0), those moves are chained to find each chunk's real
+// start, and then all chunks write their runs at once.
+static void DecodeBody( const char* begin, const char* end, int& x, int& y, Pattern& pattern ) {
+	const size_t bytes = end - begin;
+	const int numThreads = (int)std::min<size_t>( std::thread::hardware_concurrency( ), bytes / ThreadedDecodeBytes );
+	if ( numThreads <= 1 ) {
+		DecodeRuns( begin, end, x, y, &pattern );
+		return;
+	}
+	std::vector<const char*> bounds( numThreads + 1 );
+	bounds[0] = begin;
+	bounds[numThreads] = end;
+	for ( int i = 1; i < numThreads; i++ ) {
+		const char* split = std::max( begin + bytes * i / numThreads, bounds[i - 1] );
+		while ( split < end && !IsTag( *split ) )
+			split++;
+		bounds[i] = std::min( split + 1, end );
+	}
+
+	struct Cursor {
+		int X = 0;
+		int Y = 0;
+	};
+	std::vector<Cursor> moves( numThreads );
+	std::vector<std::thread> threads( numThreads );
+	for ( int i = 0; i < numThreads; i++ ) {
+		threads[i] = std::thread( [&, i]( ) {
+			DecodeRuns( bounds[i], bounds[i + 1], moves[i].X, moves[i].Y, nullptr );
+		} );
+	}
+	for ( auto& thread : threads ) thread.join( );
+
+	// A chunk that ends a row leaves the cursor at its own x; one that doesn't shifts it
+	std::vector<Cursor> starts( numThreads + 1 );
+	starts[0] = { x, y };
+	for ( int i = 0; i < numThreads; i++ ) {
+		starts[i + 1].X = moves[i].Y > 0 ? moves[i].X : starts[i].X + moves[i].X;
+		starts[i + 1].Y = starts[i].Y + moves[i].Y;
+	}
+	for ( int i = 0; i < numThreads; i++ ) {
+		threads[i] = std::thread( [&, i]( ) {
+			Cursor cursor = starts[i];
+			DecodeRuns( bounds[i], bounds[i + 1], cursor.X, cursor.Y, &pattern );
+		} );
+	}
+	for ( auto& thread : threads ) thread.join( );
+	x = starts[numThreads].X;
+	y = starts[numThreads].Y;
+}
+
+// Parse "x = 3, y = 3, rule = B3/S23"
+static bool ParseHeader( const std::string& line, RleFile& out ) {
+	int width = -1;
+	int height = -1;
+	size_t start = 0;
+	while ( start < line.size( ) ) {
+		size_t comma = line.find( ',', start );
+		if ( comma == std::string::npos )
+			comma = line.size( );
+		std::string field = line.substr( start, comma - start );
+		start = comma + 1;
+		size_t equals = field.find( '=' );
+		if ( equals == std::string::npos )
+			continue;
+		std::string key;
+		for ( char c : field.substr( 0, equals ) ) {
+			if ( !isspace( (unsigned char)c ) )
+				key += (char)tolower( (unsigned char)c );
+		}
+		std::string value = field.substr( equals + 1 );
+		value.erase( 0, value.find_first_not_of( " \t" ) );
+		value.erase( value.find_last_not_of( " \t\r" ) + 1 );
+		if ( key == "x" )
+			width = atoi( value.c_str( ) );
+		else if ( key == "y" )
+			height = atoi( value.c_str( ) );
+		else if ( key == "rule" )
+			out.HasRule = ParseRule( value, out.BirthRule, out.SurviveRule );
+	}
+	if ( width < 0 || height < 0 )
+		return false;
+	out.Cells.Width = width;
+	out.Cells.Height = height;
+	return true;
+}
+
+bool ReadRle( const std::string& path, RleFile& out, std::string& error, int clipWidth, int clipHeight, int64_t maxCells ) {
+	PROFILE_ZONE( "ReadRle" );
+	FILE* file = fopen( path.c_str( ), "rb" );
+	if ( !file ) {
+		error = "Could not open " + path;
+		return false;
+	}
+	out = RleFile( );
+	std::vector<char> buffer( BlockBytes );
+	size_t filled = fread( buffer.data( ), 1, buffer.size( ), file );
+
+	// Comment lines, then the header line
+	size_t start = 0;
+	bool header = false;
+	while ( !header ) {
+		const char* newline = (const char*)memchr( buffer.data( ) + start, '\n', filled - start );
+		if ( !newline ) {
+			// Only a header this long or a file this short gets here
+			if ( filled == buffer.size( ) || filled == start )
+				break;
+			newline = buffer.data( ) + filled;
+		}
+		std::string line( (const char*)buffer.data( ) + start, newline );
+		start = std::min<size_t>( newline - buffer.data( ) + 1, filled );
+		size_t first = line.find_first_not_of( " \t\r" );
+		if ( first == std::string::npos || line[first] == '#' )
+			continue;
+		if ( line[first] != 'x' || !ParseHeader( line, out ) )
+			break;
+		header = true;
+	}
+	if ( !header ) {
+		fclose( file );
+		error = path + " has no RLE header";
+		return false;
+	}
+	// Runs outside the kept part fall outside the pattern and are skipped
+	out.FullWidth = out.Cells.Width;
+	out.FullHeight = out.Cells.Height;
+	out.Cells.Width = std::min( out.Cells.Width, std::max( clipWidth, 0 ) );
+	out.Cells.Height = std::min( out.Cells.Height, std::max( clipHeight, 0 ) );
+	if ( (int64_t)out.Cells.Width * out.Cells.Height > maxCells ) {
+		fclose( file );
+		error = path + " is " + std::to_string( out.FullWidth ) + "x" + std::to_string( out.FullHeight ) + " cells, more than fit";
+		return false;
+	}
+	const size_t cells = (size_t)out.Cells.Width * out.Cells.Height;
+	out.Cells.Cells.assign( cells, 0 );
+
+	// Decode the body a block at a time. A block is cut after its last tag so no
+	// run count is split; the rest is carried over to the front of the next.
+	int x = 0;
+	int y = 0;
+	bool eof = filled < buffer.size( );
+	while ( true ) {
+		const char* body = buffer.data( ) + start;
+		const char* bang = (const char*)memchr( body, '!', filled - start );
+		const char* end = bang ? bang : buffer.data( ) + filled;
+		if ( !bang && !eof ) {
+			while ( end > body && !IsTag( end[-1] ) )
+				end--;
+		}
+		DecodeBody( body, end, x, y, out.Cells );
+		if ( bang || eof )
+			break;
+		size_t carried = buffer.data( ) + filled - end;
+		if ( carried == buffer.size( ) ) {
+			fclose( file );
+			error = path + " has a block without any cell tags";
+			return false;
+		}
+		memmove( buffer.data( ), end, carried );
+		start = 0;
+		filled = carried + fread( buffer.data( ) + carried, 1, buffer.size( ) - carried, file );
+		eof = filled < buffer.size( );
+	}
+	fclose( file );
+	return true;
+}
+
+// Decimal digits of value into out, returning how many
+static int FormatCount( int value, char* out ) {
+	char digits[12];
+	int length = 0;
+	do {
+		digits[length++] = (char)( '0' + value % 10 );
+		value /= 10;
+	} while ( value > 0 );
+	for ( int i = 0; i < length; i++ )
+		out[i] = digits[length - 1 - i];
+	return length;
+}
+
+// Run counts below 100 written without dividing: none for 0 and 1, then one
+// or two digits
+static const struct ShortCounts {
+	char Text[100][2];
+	int Length[100];
+
+	ShortCounts( ) {
+		for ( int count = 0; count < 100; count++ ) {
+			Length[count] = count < 2 ? 0 : count < 10 ? 1 : 2;
+			Text[count][0] = (char)( '0' + ( count < 10 ? count : count / 10 ) );
+			Text[count][1] = (char)( '0' + count % 10 );
+		}
+	}
+} shortCounts;
+
+static int LowestBit( uint64_t bits ) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64( &index, bits );
+	return (int)index;
+#else
+	return __builtin_ctzll( bits );
+#endif
+}
+
+// One bit per cell of a row, with a zero word past the end to stop RunEnd
+static void PackRow( const Cell* row, int width, std::vector<uint64_t>& words ) {
+	words.assign( width / 64 + 1, 0 );
+	PackBits( row, width, words.data( ) );
+}
+
+// First cell from x on that isn't value, or width
+static int RunEnd( const std::vector<uint64_t>& words, int x, int width, Cell value ) {
+	const uint64_t flip = value ? ~0ULL : 0;
+	size_t word = x / 64;
+	uint64_t bits = ( words[word] ^ flip ) >> ( x % 64 ) << ( x % 64 );
+	while ( !bits ) {
+		if ( ++word == words.size( ) )
+			return width;
+		bits = words[word] ^ flip;
+	}
+	return std::min( (int)( word * 64 ) + LowestBit( bits ), width );
+}
+
+// RLE for a band of rows. Row ends are counted rather than written until the
+// next run, so blank rows collapse into one "n$" and trailing ones are left
+// for the caller in PendingRows. Non-empty text ends with a newline.
+struct EncodedBand {
+	std::string Text;
+	int PendingRows = 0;
+};
+
+static void EncodeRows( const Cell* cells, int width, int startRow, int endRow, EncodedBand& band ) {
+	// Grown ahead of the longest possible row and written in place; trimmed
+	// to what was used at the end
+	std::string& text = band.Text;
+	size_t used = 0;
+	int line = 0;
+	int pending = 0;
+	std::vector<uint64_t> words;
+	// Breaking lines a whole token early keeps them under the limit without
+	// measuring each token first
+	auto emit = [&]( int count, char tag ) {
+		if ( line > MaxLineLength - MaxTokenLength ) {
+			text[used++] = '\n';
+			line = 0;
+		}
+		char* out = &text[used];
+		char* start = out;
+		if ( count < 100 ) {
+			// Copy both slots and keep as many as the count needs, so random
+			// fields' short runs don't branch on their length
+			memcpy( out, shortCounts.Text[count], 2 );
+			out += shortCounts.Length[count];
+		} else {
+			out += FormatCount( count, out );
+		}
+		*out++ = tag;
+		used += out - start;
+		line += (int)( out - start );
+	};
+	// A row is at most width tokens plus line breaks
+	const size_t rowBytes = (size_t)width * ( MaxTokenLength + 1 ) + 32;
+	for ( int y = startRow; y < endRow; y++ ) {
+		if ( text.size( ) - used < rowBytes )
+			text.resize( std::max( text.size( ) * 2, used + rowBytes ) );
+		PackRow( cells + (size_t)y * width, width, words );
+		int x = 0;
+		while ( true ) {
+			const int runStart = RunEnd( words, x, width, 0 );
+			if ( runStart == width )
+				break;
+			const int runEnd = RunEnd( words, runStart, width, 1 );
+			if ( pending > 0 ) {
+				emit( pending, '$' );
+				pending = 0;
+			}
+			if ( runStart > x )
+				emit( runStart - x, 'b' );
+			emit( runEnd - runStart, 'o' );
+			x = runEnd;
+		}
+		pending++;
+	}
+	text.resize( used );
+	if ( !text.empty( ) )
+		text += '\n';
+	band.PendingRows = pending;
+}
+
+bool WriteRle( const std::string& path, const Cell* cells, int width, int height, const Rules& rules, std::string& error ) {
+	PROFILE_ZONE( "WriteRle" );
+	FILE* file = fopen( path.c_str( ), "wb" );
+	if ( !file ) {
+		error = "Could not write " + path;
+		return false;
+	}
+	fprintf( file, "#C Written by Life23\nx = %d, y = %d, rule = %s\n", width, height, FormatRule( rules ).c_str( ) );
+
+	const size_t total = (size_t)width * height;
+	int numThreads = (int)std::min<size_t>( std::thread::hardware_concurrency( ), total / ThreadedEncodeCells );
+	numThreads = std::max( 1, std::min( numThreads, height ) );
+	std::vector<EncodedBand> bands( numThreads );
+	std::vector<std::thread> threads;
+	for ( int i = 0; i < numThreads; i++ ) {
+		int startRow = (int)( (int64_t)height * i / numThreads );
+		int endRow = (int)( (int64_t)height * ( i + 1 ) / numThreads );
+		if ( numThreads == 1 )
+			EncodeRows( cells, width, startRow, endRow, bands[i] );
+		else
+			threads.emplace_back( EncodeRows, cells, width, startRow, endRow, std::ref( bands[i] ) );
+	}
+	for ( auto& thread : threads ) thread.join( );
+
+	// Stitch the bands: row ends left over from one band go in front of the
+	// next band's first run, on a line of their own
+	int pending = 0;
+	for ( const EncodedBand& band : bands ) {
+		if ( band.Text.empty( ) ) {
+			pending += band.PendingRows;
+			continue;
+		}
+		if ( pending > 1 )
+			fprintf( file, "%d$\n", pending );
+		else if ( pending == 1 )
+			fputs( "$\n", file );
+		fwrite( band.Text.data( ), 1, band.Text.size( ), file );
+		pending = band.PendingRows;
+	}
+	fputs( "!\n", file );
+	bool written = !ferror( file );
+	if ( fclose( file ) != 0 || !written ) {
+		error = "Could not write " + path;
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+// Rle.h
+
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <string>
+
+#include "Grid.h"
+#include "Region.h"
+
+// A pattern read from an RLE file, with the rule from its header if it had one
+struct RleFile {
+	Pattern Cells;
+	int FullWidth = 0;					// Size from the header, before clipping
+	int FullHeight = 0;
+	bool HasRule = false;
+	char BirthRule[9]{};
+	char SurviveRule[9]{};
+};
+
+// Read an RLE pattern. The file is streamed in blocks rather than loaded
+// whole, and large blocks are decoded by several threads at once. Only the
+// top-left clipWidth x clipHeight of the pattern is kept; the rest is decoded
+// but not stored. Returns false with a reason in error if the file can't be
+// read, has no header, or the kept part would exceed maxCells, which is
+// checked before anything is allocated.
+bool ReadRle( const std::string& path, RleFile& out, std::string& error,
+	int clipWidth = INT_MAX, int clipHeight = INT_MAX, int64_t maxCells = INT64_MAX );
+
+// Write a width x height block of cells as RLE with a B/S rule header. Cells
+// must be 0 or 1. Bands of rows are encoded in parallel.
+bool WriteRle( const std::string& path, const Cell* cells, int width, int height, const Rules& rules, std::string& error );
+
+// Parse "B3/S23", "b3s23" or the older "23/3" survival/birth form
+bool ParseRule( const std::string& text, char birth[9], char survive[9] );
+
+// Format rules' birth and survival counts as "B3/S23"
+std::string FormatRule( const Rules& rules );
\ No newline at end of file
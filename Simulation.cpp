@@ -1,29 +1,65 @@
 // Simulation.cpp
 
 #include "Simulation.h"
+#include "Brush.h"
+#include "Macrocell.h"
+#include "Profiler.h"
+#include "Rle.h"
+#include "SnapshotFile.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
 #include <iostream>
+#include <random>
 
 Simulation::Simulation( int width, int height ) : grid( width, height ) {
+	engineName = DefaultEngineName;
+	engine = CreateEngine( engineName );
+	engine->Attach( grid );
 	ResetToDefaults( );
-	lastTick = GetTime( );
+	// Apply the defaults right away so there is a snapshot to draw on the first frame
+	std::vector<EditOp> initial;
+	edits.Drain( initial );
+	ApplyEdits( initial );
+	// Nothing to undo back to before the first world
+	undo.Clear( );
+	simSettings = pendingSettings;
+	Publish( );
+	snapshots.Acquire( );
+	simThread = std::thread( &Simulation::Run, this );
+}
+
+Simulation::~Simulation( ) {
+	{
+		std::lock_guard<std::mutex> lock( settingsMutex );
+		running = false;
+	}
+	wake.notify_one( );
+	simThread.join( );
 }
 
 void Simulation::ResetToDefaults( ) {
-	Scale = 10;
 	TicksPerSecond = 15;
-	PanX = 0;
-	PanY = 0;
-	grid.Resize( Width / Scale, Height / Scale );
-	grid.EdgeBehavior = Wrap;
-	grid.Randomize( );
+	UnlimitedTicks = false;
+	UnlimitedShare = 0.5f;
+	Camera = { { 0, 0 }, { 0, 0 }, 0, 10 };
+	ResizeGrid( Width / 10, Height / 10 );
+	Post( EditOp::Randomize( 0.5f, 0 ) );
+	rules.EdgeBehavior = Wrap;
 	AliveColor = WHITE;
 	DeadColor = BLACK;
+	ColorByAge = false;
+	OldColor = ORANGE;
+	ShowHeatmap = false;
+	HeatDecay = 4;
+	HeatColor = RED;
 	for ( size_t i = 0; i < 8; i++ ) {
-		grid.Neighborhood[i] = true;
+		rules.Neighborhood[i] = true;
 	}
 	for ( size_t i = 0; i < 9; i++ ) {
-		grid.BirthRule[i] = i == 3;
-		grid.SurviveRule[i] = i == 2 || i == 3;
+		rules.BirthRule[i] = i == 3;
+		rules.SurviveRule[i] = i == 2 || i == 3;
 	}
 	EnableGrid = false;
 	RandomField = false;
@@ -36,146 +72,828 @@ void Simulation::ResetToDefaults( ) {
 	DisableStrobing = false;
 	PreemptiveIterations = 0;
 	UseMultithreading = true;
+	EngineName = DefaultEngineName;
+	EngineStats = false;
+	PrescaleTexture = false;
+	RecordHistory = true;
+	HistoryKeyframeInterval = 64;
+	HistoryMemoryMB = 256;
+	UndoMemoryMB = 256;
+	LookAhead = 8;
+	ViewAhead = 0;
+	SyncSettings( );
 }
 
-void Simulation::Tick( ) {
-	if ( UseMultithreading )
-		grid.TickWithMultithreading( );
-	else
-		grid.Tick( );
+void Simulation::Post( const EditOp& edit ) {
+	if ( edits.Push( edit ) )
+		Wake( );
 }
 
-void Simulation::UpdateKeyboard( ) {
-	if ( grid.EdgeBehavior != Wrap ) {
-		rawPanX = 0;
-		rawPanY = 0;
-		PanX = 0;
-		PanY = 0;
+void Simulation::Post( std::vector<EditOp> batch ) {
+	if ( edits.Push( std::move( batch ) ) )
+		Wake( );
+}
+
+void Simulation::Wake( ) {
+	// The simulation thread checks the queue under the mutex before it sleeps,
+	// so taking the mutex here means the notify can't land in between
+	{
+		std::lock_guard<std::mutex> lock( settingsMutex );
+	}
+	wake.notify_one( );
+}
+
+void Simulation::Step( ) {
+	Post( EditOp::Step( ) );
+}
+
+void Simulation::ResizeGrid( int width, int height ) {
+	MarkUndo( );
+	Post( EditOp::Resize( width, height ) );
+}
+
+void Simulation::ZoomAt( Vector2 screen, float factor ) {
+	Vector2 world = GetScreenToWorld2D( screen, Camera );
+	Camera.zoom = std::max( MinZoom, std::min( Camera.zoom * factor, MaxZoom ) );
+	Camera.target = { world.x - screen.x / Camera.zoom, world.y - screen.y / Camera.zoom };
+	ClampCamera( );
+}
+
+void Simulation::FitCamera( ) {
+	const GridSnapshot& snapshot = snapshots.Read( );
+	if ( snapshot.Width == 0 || snapshot.Height == 0 )
+		return;
+	float zoom = std::min( (float)Width / snapshot.Width, (float)Height / snapshot.Height );
+	Camera.zoom = std::max( MinZoom, std::min( zoom, MaxZoom ) );
+	Camera.target = { ( snapshot.Width - Width / Camera.zoom ) / 2, ( snapshot.Height - Height / Camera.zoom ) / 2 };
+	ClampCamera( );
+}
+
+int Simulation::ZoomLevel( ) {
+	// Deep enough that a level's pixel covers at least one screen pixel, so
+	// point sampling never skips a block
+	int level = 0;
+	while ( level < MaxZoomLevel && Camera.zoom * ( 1 << level ) < 1.0f )
+		level++;
+	return level;
+}
+
+void Simulation::ClampCamera( ) {
+	const GridSnapshot& snapshot = snapshots.Read( );
+	if ( snapshot.Width == 0 || snapshot.Height == 0 )
+		return;
+	if ( rules.EdgeBehavior == Wrap ) {
+		Camera.target.x -= std::floor( Camera.target.x / snapshot.Width ) * snapshot.Width;
+		Camera.target.y -= std::floor( Camera.target.y / snapshot.Height ) * snapshot.Height;
 		return;
 	}
-	const float panSpeed = 60.0 * GetFrameTime( );
-	if ( IsKeyDown( KEY_LEFT ) )
-		rawPanX -= panSpeed;
-	if ( IsKeyDown( KEY_RIGHT ) )
-		rawPanX += panSpeed;
-	if ( IsKeyDown( KEY_UP ) )
-		rawPanY -= panSpeed;
-	if ( IsKeyDown( KEY_DOWN ) )
-		rawPanY += panSpeed;
-	PanX = MOD_POSITIVE( (int)rawPanX, grid.GetWidth( ) );
-	PanY = MOD_POSITIVE( (int)rawPanY, grid.GetHeight( ) );
+	const float halfWidth = Width / Camera.zoom / 2;
+	const float halfHeight = Height / Camera.zoom / 2;
+	Camera.target.x = std::max( -halfWidth, std::min( Camera.target.x, snapshot.Width - halfWidth ) );
+	Camera.target.y = std::max( -halfHeight, std::min( Camera.target.y, snapshot.Height - halfHeight ) );
+}
+
+Rectangle Simulation::VisibleCells( ) {
+	Rectangle view = { Camera.target.x, Camera.target.y, Width / Camera.zoom, Height / Camera.zoom };
+	if ( rules.EdgeBehavior == Wrap )
+		return view;
+	// Without wrapping there is nothing outside the world to draw
+	const GridSnapshot& snapshot = snapshots.Read( );
+	float x0 = std::max( view.x, 0.0f );
+	float y0 = std::max( view.y, 0.0f );
+	float x1 = std::min( view.x + view.width, (float)snapshot.Width );
+	float y1 = std::min( view.y + view.height, (float)snapshot.Height );
+	return { x0, y0, std::max( x1 - x0, 0.0f ), std::max( y1 - y0, 0.0f ) };
+}
+
+void Simulation::ResetCounters( ) {
+	Post( EditOp::ResetCounters( ) );
+}
+
+void Simulation::QueueRules( std::vector<EditOp>& batch ) {
+	if ( rules != postedRules ) {
+		batch.push_back( EditOp::SetRules( rules ) );
+		postedRules = rules;
+	}
+}
+
+void Simulation::SyncSettings( ) {
+	if ( rules != postedRules ) {
+		Post( EditOp::SetRules( rules ) );
+		postedRules = rules;
+	}
+	SimSettings settings;
+	settings.TicksPerSecond = TicksPerSecond;
+	settings.Paused = Paused;
+	settings.UseMultithreading = UseMultithreading;
+	settings.UsePerfCounters = UsePerfCounters;
+	settings.UnlimitedTicks = UnlimitedTicks;
+	settings.UnlimitedShare = UnlimitedShare;
+	settings.RecordHistory = RecordHistory;
+	settings.HistoryKeyframeInterval = HistoryKeyframeInterval;
+	settings.HistoryMemoryMB = HistoryMemoryMB;
+	settings.UndoMemoryMB = UndoMemoryMB;
+	settings.LookAhead = LookAhead;
+	settings.TrackAges = ColorByAge;
+	settings.TrackHeat = ShowHeatmap;
+	settings.HeatDecay = HeatDecay;
+	settings.Engine = EngineName;
+	settings.EngineStats = EngineStats;
+	settings.FrameTime = std::min( std::max( (double)GetFrameTime( ), 1.0 / 240 ), 0.1 );
+	bool changed;
+	{
+		std::lock_guard<std::mutex> lock( settingsMutex );
+		// The simulation thread puts the running engine back when there is none
+		// by the name asked for; show that unless another has been picked since
+		if ( pendingSettings.Engine != postedEngine && settings.Engine == postedEngine )
+			EngineName = settings.Engine = pendingSettings.Engine;
+		postedEngine = settings.Engine;
+		changed = settings.Paused != pendingSettings.Paused
+			|| settings.TrackAges != pendingSettings.TrackAges
+			|| settings.TrackHeat != pendingSettings.TrackHeat
+			|| settings.Engine != pendingSettings.Engine
+			|| settings.EngineStats != pendingSettings.EngineStats
+			|| settings.TicksPerSecond != pendingSettings.TicksPerSecond
+			|| settings.UnlimitedTicks != pendingSettings.UnlimitedTicks;
+		pendingSettings = settings;
+	}
+	if ( changed )
+		wake.notify_one( );
 }
 
-void Simulation::PlotLine( int x0, int y0, int x1, int y1, bool value, int size = 1 ) {
-	float dx = abs( x1 - x0 );
-	float sx = x0 < x1 ? 1 : -1;
-	float dy = -abs( y1 - y0 );
-	float sy = y0 < y1 ? 1 : -1;
-	float error = dx + dy;
-	while ( true ) {
-		Plot( x0, y0, value, size );
-		if ( x0 == x1 and y0 == y1 ) break;
-		float e2 = 2 * error;
-		if ( e2 >= dy ) {
-			if ( x0 == x1 ) break;
-			error += dy;
-			x0 += sx;
+void Simulation::Run( ) {
+	Profiler::SetThreadName( "Simulation" );
+	auto clockStart = std::chrono::steady_clock::now( );
+	auto seconds = [clockStart]( ) {
+		return std::chrono::duration<double>( std::chrono::steady_clock::now( ) - clockStart ).count( );
+	};
+	std::vector<EditOp> batch;
+	double lastTime = seconds( );
+	std::unique_lock<std::mutex> lock( settingsMutex );
+	while ( running ) {
+		simSettings = pendingSettings;
+		lock.unlock( );
+
+		// A new engine takes the world over between generations
+		if ( simSettings.Engine != engineName ) {
+			std::unique_ptr<Engine> next = CreateEngine( simSettings.Engine );
+			if ( next ) {
+				engine->Detach( );
+				engine = std::move( next );
+				engine->Attach( grid );
+				engine->TrackAges( trackingAges );
+				engine->TrackHeat( trackingHeat );
+				engineName = simSettings.Engine;
+				Publish( );
+			} else {
+				// Nothing is registered by that name; keep the running engine
+				lock.lock( );
+				if ( pendingSettings.Engine == simSettings.Engine )
+					pendingSettings.Engine = engineName;
+				lock.unlock( );
+				simSettings.Engine = engineName;
+			}
+		}
+		engine->SetHeatDecay( simSettings.HeatDecay );
+		if ( trackingAges != simSettings.TrackAges || trackingHeat != simSettings.TrackHeat ) {
+			trackingAges = simSettings.TrackAges;
+			trackingHeat = simSettings.TrackHeat;
+			engine->TrackAges( trackingAges );
+			engine->TrackHeat( trackingHeat );
+			Publish( );
+		}
+
+		// Edits land between generations, never in the middle of one
+		edits.Drain( batch );
+		bool changed = !batch.empty( );
+		ApplyEdits( batch );
+		batch.clear( );
+		// A finished warm-up replaces the world between generations like any edit
+		if ( warmUp.Finished( ) )
+			changed |= warmUp.Collect( *engine );
+
+		double now = seconds( );
+		double idle = 0;
+		if ( simSettings.Paused ) {
+			tickAccumulator = 0;
+			// Idle cores work out the next generations, starting over after any
+			// edit. Checkpoints carry no ages or heat, so there is none while
+			// either is tracked.
+			if ( simSettings.LookAhead > 0 && !engine->TracksAges( ) && !engine->TracksHeat( ) )
+				speculation.Start( *engine, engineName, simSettings.LookAhead, simSettings.UseMultithreading, [this]( ) { Wake( ); } );
+			else
+				speculation.Stop( *engine );
+		} else {
+			// Running takes up whatever was computed ahead, but computes no more
+			speculation.Stop( *engine );
+			// Fixed timestep: every elapsed tickTime owes one generation, however many
+			// that is per frame, but a batch never runs longer than the budget.
+			const bool unlimited = simSettings.UnlimitedTicks;
+			const double tickTime = 1.0 / std::max( simSettings.TicksPerSecond, 1 );
+			const double budget = simSettings.FrameTime * ( unlimited ? simSettings.UnlimitedShare : 1.0 );
+			// Size unlimited batches from the measured cost so they end near the budget
+			const int batchSize = unlimited ? std::max( 1, (int)( budget / tickCost ) ) : INT_MAX;
+			tickAccumulator += now - lastTime;
+			int ran = 0;
+			double elapsed = 0;
+			while ( ran < batchSize && elapsed < budget && ( unlimited || tickAccumulator >= tickTime ) ) {
+				double tickStart = seconds( );
+				Tick( );
+				double cost = seconds( ) - tickStart;
+				tickCost += ( cost - tickCost ) * 0.2;
+				elapsed += cost;
+				ran++;
+				if ( !unlimited )
+					tickAccumulator -= tickTime;
+			}
+			changed |= ran > 0;
+			if ( unlimited ) {
+				// Leave the rest of the frame to the UI
+				tickAccumulator = 0;
+				idle = simSettings.FrameTime - elapsed;
+			} else {
+				// Ticks slower than the requested rate: keep at most one budget of
+				// backlog instead of falling further behind forever
+				tickAccumulator = std::min( tickAccumulator, std::max( budget, tickTime ) );
+				idle = tickTime - tickAccumulator;
+			}
 		}
-		if ( e2 <= dx ) {
-			if ( y0 == y1 ) break;
-			error += dx;
-			y0 += sy;
+		lastTime = now;
+		if ( changed )
+			Publish( );
+
+		lock.lock( );
+		if ( edits.Empty( ) && running && !warmUp.Finished( ) && !speculation.Finished( ) ) {
+			if ( pendingSettings.Paused )
+				wake.wait( lock );
+			else if ( idle > 0 )
+				wake.wait_for( lock, std::chrono::duration<double>( idle ) );
 		}
 	}
 }
 
-void Simulation::Plot( int x, int y, bool value, int size = 1 ) {
-	if ( BrushRound )
-		PlotCircle( x, y, value, size );
-	else
-		PlotSquare( x, y, value, size );
+void Simulation::ApplyEdits( std::vector<EditOp>& batch ) {
+	PROFILE_ZONE( "Simulation::ApplyEdits" );
+	size_t i = 0;
+	while ( i < batch.size( ) ) {
+		if ( batch[i].Type != EditFillSpan ) {
+			Apply( batch[i++] );
+			continue;
+		}
+		// A drag queues a span per row per frame; while ticks are slow these pile
+		// up over the same rows, so merge them before writing
+		size_t end = i;
+		while ( end < batch.size( ) && batch[end].Type == EditFillSpan )
+			end++;
+		CoalesceSpans( batch.data( ) + i, batch.data( ) + end, engine->GetWidth( ), engine->GetHeight( ), engine->GetRules( ).EdgeBehavior == Wrap, coalesced );
+		for ( const EditOp& edit : coalesced )
+			engine->WriteSpan( edit.Row.Y, edit.Row.X0, edit.Row.X1, edit.Value );
+		i = end;
+	}
 }
 
-void Simulation::PlotSquare( int x, int y, bool value, int size = 1 ) {
-	if ( size <= 1 ) {
-		grid.Set( x, y, value );
-		return;
+void Simulation::Apply( const EditOp& edit ) {
+	switch ( edit.Type ) {
+	case EditFillSpan:
+		engine->WriteSpan( edit.Row.Y, edit.Row.X0, edit.Row.X1, edit.Value );
+		break;
+	case EditFillRect:
+		for ( int y = edit.Rect.Y; y < edit.Rect.Y + edit.Rect.Height; y++ )
+			engine->WriteSpan( y, edit.Rect.X, edit.Rect.X + edit.Rect.Width - 1, edit.Value );
+		break;
+	case EditFloodFill:
+		engine->FloodFill( edit.Point.X, edit.Point.Y, edit.Value );
+		break;
+	case EditPaste:
+		engine->Paste( edit.Block.X, edit.Block.Y, *edit.Block.Cells );
+		delete edit.Block.Cells;
+		break;
+	case EditRotate:
+	case EditFlipHorizontal:
+	case EditFlipVertical: {
+		Pattern block;
+		engine->ReadRect( edit.Rect.X, edit.Rect.Y, edit.Rect.Width, edit.Rect.Height, block );
+		if ( edit.Type == EditRotate ) {
+			// The turned block is the region's height wide, so clear what it leaves behind
+			for ( int y = edit.Rect.Y; y < edit.Rect.Y + edit.Rect.Height; y++ )
+				engine->WriteSpan( y, edit.Rect.X, edit.Rect.X + edit.Rect.Width - 1, 0 );
+			block = RotateClockwise( block );
+		} else if ( edit.Type == EditFlipHorizontal ) {
+			FlipHorizontal( block );
+		} else {
+			FlipVertical( block );
+		}
+		engine->Paste( edit.Rect.X, edit.Rect.Y, block );
+		break;
 	}
-	for ( int cy = y; cy <= y + size; cy++ ) {
-		for ( int cx = x; cx <= x + size; cx++ ) {
-			grid.Set( cx, cy, value );
+	case EditClear:
+		warmUp.Cancel( );
+		engine->Clear( );
+		break;
+	case EditRandomize: {
+		const uint32_t seed = edit.Random.HasSeed ? edit.Random.Seed : std::random_device( )( );
+		if ( edit.Random.Iterations <= 0 ) {
+			warmUp.Cancel( );
+			engine->Randomize( edit.Random.Percent, seed );
+			break;
 		}
+		// Warm up a new field in the background on an engine of the same kind;
+		// the world carries on as it is until the field has run every iteration
+		auto field = std::make_unique<Grid>( engine->GetWidth( ), engine->GetHeight( ) );
+		field->SetRules( engine->GetRules( ) );
+		field->Generation = engine->GetGeneration( );
+		std::unique_ptr<Engine> worker = CreateEngine( engineName );
+		worker->Attach( *field );
+		worker->Randomize( edit.Random.Percent, seed );
+		warmUp.Start( std::move( field ), std::move( worker ), edit.Random.Iterations, simSettings.UseMultithreading, [this]( ) { Wake( ); } );
+		break;
+	}
+	case EditSetRules:
+		engine->SetRules( edit.NewRules );
+		break;
+	case EditResize:
+		warmUp.Cancel( );
+		engine->Resize( edit.Size.Width, edit.Size.Height );
+		break;
+	case EditLoad:
+		warmUp.Cancel( );
+		engine->Load( edit.World.Width, edit.World.Height, *edit.World.Cells, edit.World.Generation, edit.World.Seed );
+		delete edit.World.Cells;
+		break;
+	case EditStep:
+		Tick( );
+		break;
+	case EditSeek: {
+		int width, height;
+		std::vector<Cell> cells;
+		warmUp.Cancel( );
+		if ( history.Seek( edit.Rewind.Generation, width, height, cells ) )
+			engine->Load( width, height, cells, edit.Rewind.Generation, engine->GetSeed( ) );
+		break;
+	}
+	case EditCheckpoint:
+		undo.SetBudget( (size_t)simSettings.UndoMemoryMB << 20 );
+		undo.Push( engine->Checkpoint( ) );
+		break;
+	case EditUndo:
+	case EditRedo: {
+		warmUp.Cancel( );
+		GridCheckpoint state;
+		const bool moved = edit.Type == EditUndo ? undo.Undo( engine->Checkpoint( ), state ) : undo.Redo( engine->Checkpoint( ), state );
+		if ( moved )
+			engine->Restore( state );
+		break;
+	}
+	case EditResetCounters:
+		totalCounters = PerfSample( );
+		break;
 	}
 }
 
-void Simulation::PlotCircle( int x, int y, bool value, int size = 1 ) {
-	if ( size <= 1 ) {
-		grid.Set( x, y, value );
-		return;
+void Simulation::Tick( ) {
+	PROFILE_ZONE( "Simulation::Tick" );
+	// A generation computed ahead is taken as it is, leaving the counters
+	// alone, unless ages or heat need counting through the tick
+	if ( engine->TracksAges( ) || engine->TracksHeat( ) || !speculation.Take( *engine ) ) {
+		if ( simSettings.UsePerfCounters ) {
+			if ( !counters.IsOpen( ) )
+				counters.Open( );
+			counters.Start( );
+		}
+		engine->Step( 1, simSettings.UseMultithreading );
+		if ( simSettings.UsePerfCounters ) {
+			lastTickCounters = counters.Stop( (uint64_t)engine->GetWidth( ) * engine->GetHeight( ) );
+			totalCounters.Add( lastTickCounters );
+		}
 	}
-	float sizeSq = size * size * 0.25;
-	for ( int cy = y; cy <= y + size; cy++ ) {
-		int py = abs( cy - y - size / 2 );
-		for ( int cx = x; cx <= x + size; cx++ ) {
-			int px = abs( cx - x - size / 2 );
-			if ( px * px + py * py <= sizeSq )
-				grid.Set( cx, cy, value );
+	if ( simSettings.RecordHistory ) {
+		history.SetLimits( simSettings.HistoryKeyframeInterval, (size_t)simSettings.HistoryMemoryMB << 20 );
+		history.Record( *engine );
+	} else {
+		history.Clear( );
+	}
+	exporter.Submit( *engine );
+}
+
+void Simulation::Publish( ) {
+	PROFILE_ZONE( "Simulation::Publish" );
+	GridSnapshot& snapshot = snapshots.Write( );
+	const int width = engine->GetWidth( );
+	const int height = engine->GetHeight( );
+	// This buffer was last filled a couple of publishes ago; only rows that
+	// changed since then need copying
+	const bool full = snapshot.Width != width || snapshot.Height != height;
+	snapshot.Width = width;
+	snapshot.Height = height;
+	snapshot.Generation = engine->GetGeneration( );
+	snapshot.Seed = engine->GetSeed( );
+	snapshot.Version = ++publishedVersion;
+	snapshot.LastTickCounters = lastTickCounters;
+	snapshot.TotalCounters = totalCounters;
+	snapshot.Cells.resize( (size_t)width * height );
+	snapshot.RowStamps.resize( height );
+	// Runs of changed rows are read from the engine a block at a time
+	auto rowChanged = [&]( int y ) {
+		return full || engine->RowStamp( y ) > snapshot.Stamp;
+	};
+	for ( int y = 0; y < height; ) {
+		if ( !rowChanged( y ) ) {
+			y++;
+			continue;
+		}
+		int end = y + 1;
+		while ( end < height && rowChanged( end ) )
+			end++;
+		engine->ReadRect( 0, y, width, end - y, publishRows );
+		std::copy( publishRows.Cells.begin( ), publishRows.Cells.end( ), snapshot.Cells.begin( ) + (size_t)y * width );
+		y = end;
+	}
+	// Ages are copied with their rows; a buffer that had none yet needs them all
+	const bool ages = engine->TracksAges( );
+	const bool fullAges = ages && snapshot.Ages.size( ) != snapshot.Cells.size( );
+	if ( ages )
+		snapshot.Ages.resize( snapshot.Cells.size( ) );
+	else
+		snapshot.Ages.clear( );
+	for ( int y = 0; y < height; y++ ) {
+		uint64_t stamp = engine->RowStamp( y );
+		if ( ages && ( full || fullAges || stamp > snapshot.Stamp ) ) {
+			// Cells set since the last tick have no age yet but are drawn as newborn
+			const Cell* cells = snapshot.Cells.data( ) + (size_t)y * width;
+			const uint8_t* age = engine->AgeRow( y );
+			uint8_t* target = snapshot.Ages.data( ) + (size_t)y * width;
+			for ( int x = 0; x < width; x++ )
+				target[x] = cells[x] ? std::max<uint8_t>( age[x], 1 ) : 0;
 		}
+		snapshot.RowStamps[y] = stamp;
+	}
+	if ( simSettings.EngineStats ) {
+		snapshot.Population = engine->Population( );
+		snapshot.Hash = engine->Hash( );
+	}
+	// Heat changes wherever it has not cooled off, so it is copied whole
+	if ( engine->TracksHeat( ) ) {
+		snapshot.Heat.resize( snapshot.Cells.size( ) );
+		if ( height > 0 )
+			std::copy( engine->HeatRow( 0 ), engine->HeatRow( 0 ) + snapshot.Heat.size( ), snapshot.Heat.begin( ) );
+	} else {
+		snapshot.Heat.clear( );
 	}
+	snapshot.Stamp = engine->GetStamp( );
+	engine->AdvanceStamp( );
+	snapshots.Publish( );
+}
+
+void Simulation::UpdateKeyboard( ) {
+	// Pan at a constant speed on screen, whatever the zoom
+	const float panSpeed = 600.0f * GetFrameTime( ) / Camera.zoom;
+	if ( IsKeyDown( KEY_LEFT ) )
+		Camera.target.x -= panSpeed;
+	if ( IsKeyDown( KEY_RIGHT ) )
+		Camera.target.x += panSpeed;
+	if ( IsKeyDown( KEY_UP ) )
+		Camera.target.y -= panSpeed;
+	if ( IsKeyDown( KEY_DOWN ) )
+		Camera.target.y += panSpeed;
+	const Vector2 center = { Width / 2.0f, Height / 2.0f };
+	if ( IsKeyDown( KEY_EQUAL ) )
+		ZoomAt( center, std::pow( 2.0f, 2 * GetFrameTime( ) ) );
+	if ( IsKeyDown( KEY_MINUS ) )
+		ZoomAt( center, std::pow( 2.0f, -2 * GetFrameTime( ) ) );
+	if ( IsKeyPressed( KEY_HOME ) )
+		FitCamera( );
+
+	const bool control = IsKeyDown( KEY_LEFT_CONTROL ) || IsKeyDown( KEY_RIGHT_CONTROL );
+	const bool shift = IsKeyDown( KEY_LEFT_SHIFT ) || IsKeyDown( KEY_RIGHT_SHIFT );
+	if ( IsKeyPressed( KEY_B ) )
+		Tool = ToolBrush;
+	if ( IsKeyPressed( KEY_G ) )
+		Tool = ToolBucket;
+	if ( IsKeyPressed( KEY_S ) )
+		Tool = ToolSelect;
+	if ( control && IsKeyPressed( KEY_C ) )
+		CopySelection( );
+	if ( control && IsKeyPressed( KEY_X ) )
+		CutSelection( );
+	if ( control && IsKeyPressed( KEY_V ) )
+		Paste( MouseCellX( ), MouseCellY( ) );
+	if ( IsKeyPressed( KEY_DELETE ) )
+		DeleteSelection( );
+	if ( IsKeyPressed( KEY_ESCAPE ) )
+		Selected = Selection( );
+	if ( IsKeyPressed( KEY_R ) )
+		RotateSelection( );
+	if ( IsKeyPressed( KEY_H ) )
+		FlipSelection( !shift );
+	if ( control && IsKeyPressed( KEY_Z ) ) {
+		if ( shift )
+			Redo( );
+		else
+			Undo( );
+	}
+	if ( control && IsKeyPressed( KEY_Y ) )
+		Redo( );
+}
+
+int Simulation::MouseCellX( ) {
+	return (int)std::floor( GetScreenToWorld2D( GetMousePosition( ), Camera ).x );
+}
+
+int Simulation::MouseCellY( ) {
+	return (int)std::floor( GetScreenToWorld2D( GetMousePosition( ), Camera ).y );
 }
 
 void Simulation::UpdateMouse( ) {
-	BrushRound ^= IsMouseButtonPressed( MOUSE_BUTTON_MIDDLE );
-	BrushSize += (int)GetMouseWheelMove( );
+	// Middle button: a click toggles the round brush, a drag pans the camera
+	if ( IsMouseButtonPressed( MOUSE_BUTTON_MIDDLE ) ) {
+		middleStart = GetMousePosition( );
+		middleDragged = false;
+	}
+	if ( IsMouseButtonDown( MOUSE_BUTTON_MIDDLE ) ) {
+		Vector2 mouse = GetMousePosition( );
+		if ( std::fabs( mouse.x - middleStart.x ) + std::fabs( mouse.y - middleStart.y ) > 4 )
+			middleDragged = true;
+		if ( middleDragged ) {
+			Vector2 delta = GetMouseDelta( );
+			Camera.target.x -= delta.x / Camera.zoom;
+			Camera.target.y -= delta.y / Camera.zoom;
+		}
+	}
+	if ( IsMouseButtonReleased( MOUSE_BUTTON_MIDDLE ) && !middleDragged )
+		BrushRound ^= true;
+	// Ctrl + wheel zooms around the cursor, the wheel alone sizes the brush
+	if ( IsKeyDown( KEY_LEFT_CONTROL ) || IsKeyDown( KEY_RIGHT_CONTROL ) )
+		ZoomAt( GetMousePosition( ), std::pow( 2.0f, GetMouseWheelMove( ) / 4 ) );
+	else
+		BrushSize += (int)GetMouseWheelMove( );
 	if ( BrushSize < 0 )
 		BrushSize = 0;
-	const int max = std::min( grid.GetWidth( ), grid.GetHeight( ) ) / 2;
+	const GridSnapshot& snapshot = snapshots.Read( );
+	const int max = std::min( snapshot.Width, snapshot.Height ) / 2;
 	if ( BrushSize > max )
 		BrushSize = max;
 	int button = IsMouseButtonDown( MOUSE_BUTTON_LEFT ) ? MOUSE_BUTTON_LEFT : IsMouseButtonDown( MOUSE_BUTTON_RIGHT ) ? MOUSE_BUTTON_RIGHT : -1;
 	bool dragging = lastButton == button;
 	lastButton = button;
 	if ( button < 0 ) return;
+	Cell value = button == MOUSE_BUTTON_LEFT;
+
+	if ( Tool == ToolBucket ) {
+		if ( !dragging ) {
+			MarkUndo( );
+			Post( EditOp::FloodFill( MouseCellX( ), MouseCellY( ), value ) );
+		}
+		return;
+	}
+	if ( Tool == ToolSelect ) {
+		// Left drags out a selection between the two corner cells, right drops it
+		if ( button == MOUSE_BUTTON_RIGHT ) {
+			Selected = Selection( );
+			return;
+		}
+		if ( !dragging ) {
+			selectStartX = MouseCellX( );
+			selectStartY = MouseCellY( );
+		}
+		Selected.X = std::min( selectStartX, MouseCellX( ) );
+		Selected.Y = std::min( selectStartY, MouseCellY( ) );
+		Selected.Width = std::abs( MouseCellX( ) - selectStartX ) + 1;
+		Selected.Height = std::abs( MouseCellY( ) - selectStartY ) + 1;
+		return;
+	}
+
 	float offset = BrushSize % 2 ? 0 : 0.5f;
 	float radius = BrushSize / 2.0f;
-	int ox = (int)( ( (float)GetMouseX( ) - offset ) / Scale - radius );
-	int oy = (int)( ( (float)GetMouseY( ) - offset ) / Scale - radius );
-	ox += PanX;
-	oy += PanY;
-	bool value = button == MOUSE_BUTTON_LEFT;
-	if ( dragging ) {
-		PlotLine( lastX, lastY, ox, oy, value, BrushSize );
-	} else {
-		Plot( ox, oy, value, BrushSize );
-	}
+	Vector2 world = GetScreenToWorld2D( { GetMouseX( ) - offset, GetMouseY( ) - offset }, Camera );
+	int ox = (int)std::floor( world.x - radius );
+	int oy = (int)std::floor( world.y - radius );
+	// A drag sweeps the brush from where it was last frame; a click stamps it once
+	// and starts a stroke that undoes as a whole
+	if ( !dragging )
+		MarkUndo( );
+	std::vector<Span> spans;
+	RasterizeStroke( dragging ? lastX : ox, dragging ? lastY : oy, ox, oy, BrushSize, BrushRound, spans );
+	std::vector<EditOp> stroke;
+	stroke.reserve( spans.size( ) );
+	for ( const Span& span : spans )
+		stroke.push_back( EditOp::FillSpan( span, value ) );
+	Post( std::move( stroke ) );
 	lastX = ox;
 	lastY = oy;
 }
 
-void Simulation::Update( bool suppressKeyboardUpdate = false, bool suppressMouseUpdate = false ) {
-	tickTime = 1.0 / TicksPerSecond;
-	if ( !Paused ) {
-		totalTime += GetFrameTime( );
-		if ( lastTick + tickTime <= totalTime ) {
-			lastTick = totalTime;
-			Tick( );
-			ticks++;
-		}
-		if ( totalTime > lastTickRateUpdate ) {
-			ActualTickRate = ticks;
-			lastTickRateUpdate = totalTime;
-			ticks = 0;
-		}
+void Simulation::MarkUndo( ) {
+	Post( EditOp::Checkpoint( ) );
+}
+
+void Simulation::Undo( ) {
+	Post( EditOp::Undo( ) );
+}
+
+void Simulation::Redo( ) {
+	Post( EditOp::Redo( ) );
+}
+
+void Simulation::CopySelection( ) {
+	if ( Selected.Width <= 0 || Selected.Height <= 0 )
+		return;
+	const GridSnapshot& snapshot = snapshots.Read( );
+	CopyBlock( snapshot.Cells.data( ), snapshot.Width, snapshot.Height, rules.EdgeBehavior == Wrap,
+		Selected.X, Selected.Y, Selected.Width, Selected.Height, Clipboard );
+}
+
+void Simulation::CutSelection( ) {
+	CopySelection( );
+	DeleteSelection( );
+}
+
+void Simulation::DeleteSelection( ) {
+	if ( Selected.Width <= 0 || Selected.Height <= 0 )
+		return;
+	MarkUndo( );
+	Post( EditOp::FillRect( Selected.X, Selected.Y, Selected.Width, Selected.Height, 0 ) );
+}
+
+void Simulation::Paste( int x, int y ) {
+	if ( Clipboard.Width <= 0 || Clipboard.Height <= 0 )
+		return;
+	MarkUndo( );
+	Post( EditOp::Paste( x, y, Clipboard ) );
+	Selected = { x, y, Clipboard.Width, Clipboard.Height };
+}
+
+void Simulation::RotateSelection( ) {
+	if ( Selected.Width <= 0 || Selected.Height <= 0 )
+		return;
+	MarkUndo( );
+	Post( EditOp::Rotate( Selected.X, Selected.Y, Selected.Width, Selected.Height ) );
+	std::swap( Selected.Width, Selected.Height );
+}
+
+void Simulation::FlipSelection( bool horizontal ) {
+	if ( Selected.Width <= 0 || Selected.Height <= 0 )
+		return;
+	MarkUndo( );
+	if ( horizontal )
+		Post( EditOp::FlipHorizontal( Selected.X, Selected.Y, Selected.Width, Selected.Height ) );
+	else
+		Post( EditOp::FlipVertical( Selected.X, Selected.Y, Selected.Width, Selected.Height ) );
+}
+
+bool Simulation::LoadPattern( const std::string& path, int x, int y, bool resizeWorld, std::string& error ) {
+	// A pasted pattern keeps only what fits in the world; a resized world
+	// must stay within the largest one. Either way no more is allocated.
+	RleFile file;
+	const GridSnapshot& snapshot = snapshots.Read( );
+	const bool read = resizeWorld ? ReadRle( path, file, error, INT_MAX, INT_MAX, MaxWorldCells )
+		: ReadRle( path, file, error, snapshot.Width, snapshot.Height );
+	if ( !read )
+		return false;
+	if ( file.Cells.Width <= 0 || file.Cells.Height <= 0 ) {
+		error = path + " is empty";
+		return false;
+	}
+	if ( file.HasRule ) {
+		std::copy( file.BirthRule, file.BirthRule + 9, rules.BirthRule );
+		std::copy( file.SurviveRule, file.SurviveRule + 9, rules.SurviveRule );
+	}
+	// The header's rule goes out in the same batch, ahead of the pattern
+	std::vector<EditOp> batch;
+	batch.push_back( EditOp::Checkpoint( ) );
+	QueueRules( batch );
+	if ( resizeWorld ) {
+		batch.push_back( EditOp::Resize( file.Cells.Width, file.Cells.Height ) );
+		x = 0;
+		y = 0;
+	}
+	Selected = { x, y, file.Cells.Width, file.Cells.Height };
+	batch.push_back( EditOp::Paste( x, y, std::move( file.Cells ) ) );
+	Post( std::move( batch ) );
+	return true;
+}
+
+bool Simulation::SavePattern( const std::string& path, std::string& error ) {
+	const GridSnapshot& snapshot = snapshots.Read( );
+	if ( Selected.Width <= 0 || Selected.Height <= 0 )
+		return WriteRle( path, snapshot.Cells.data( ), snapshot.Width, snapshot.Height, rules, error );
+	Pattern block;
+	CopyBlock( snapshot.Cells.data( ), snapshot.Width, snapshot.Height, rules.EdgeBehavior == Wrap,
+		Selected.X, Selected.Y, Selected.Width, Selected.Height, block );
+	return WriteRle( path, block.Cells.data( ), block.Width, block.Height, rules, error );
+}
+
+bool Simulation::SaveWorld( const std::string& path, bool bitPacked, std::string& error ) {
+	const GridSnapshot& snapshot = snapshots.Read( );
+	SnapshotInfo info;
+	info.Width = snapshot.Width;
+	info.Height = snapshot.Height;
+	info.WorldRules = rules;
+	info.Generation = snapshot.Generation;
+	info.Seed = snapshot.Seed;
+	return WriteSnapshotFile( path, info, snapshot.Cells.data( ), bitPacked, error );
+}
+
+bool Simulation::SaveHeatmap( const std::string& path, std::string& error ) {
+	return ExportHeatmap( path, snapshots.Read( ), DeadColor, HeatColor, error );
+}
+
+bool Simulation::LoadWorld( const std::string& path, std::string& error ) {
+	SnapshotInfo info;
+	std::vector<Cell> cells;
+	// The renderer and the snapshot buffers are sized for worlds the GUI creates
+	if ( !ReadSnapshotFile( path, info, cells, error, MaxWorldCells ) )
+		return false;
+	// One batch, so the world is never ticked under the old rules
+	rules = info.WorldRules;
+	Selected = { };
+	std::vector<EditOp> batch;
+	batch.push_back( EditOp::Checkpoint( ) );
+	QueueRules( batch );
+	batch.push_back( EditOp::Load( info.Width, info.Height, std::move( cells ), info.Generation, info.Seed ) );
+	Post( std::move( batch ) );
+	return true;
+}
+
+bool Simulation::LoadMacrocell( const std::string& path, std::string& error ) {
+	MacrocellFile file;
+	if ( !ReadMacrocell( path, file, error ) )
+		return false;
+	if ( file.HasRule ) {
+		std::copy( file.BirthRule, file.BirthRule + 9, rules.BirthRule );
+		std::copy( file.SurviveRule, file.SurviveRule + 9, rules.SurviveRule );
+	}
+	Macrocell = std::move( file.Tree );
+	int64_t x, y, width, height;
+	if ( !Macrocell.Bounds( x, y, width, height ) ) {
+		error = path + " is empty";
+		return false;
+	}
+	const GridSnapshot& snapshot = snapshots.Read( );
+	MacrocellX = x + width / 2 - snapshot.Width / 2;
+	MacrocellY = y + height / 2 - snapshot.Height / 2;
+	MaterializeMacrocell( );
+	return true;
+}
+
+void Simulation::MaterializeMacrocell( ) {
+	const GridSnapshot& snapshot = snapshots.Read( );
+	Pattern window;
+	Macrocell.Materialize( MacrocellX, MacrocellY, snapshot.Width, snapshot.Height, window );
+	Selected = { };
+	// A loaded file's rule goes out in the same batch, ahead of its cells
+	std::vector<EditOp> batch;
+	batch.push_back( EditOp::Checkpoint( ) );
+	QueueRules( batch );
+	batch.push_back( EditOp::Paste( 0, 0, std::move( window ) ) );
+	Post( std::move( batch ) );
+}
+
+bool Simulation::SaveMacrocell( const std::string& path, std::string& error ) {
+	const GridSnapshot& snapshot = snapshots.Read( );
+	Quadtree tree;
+	if ( Selected.Width <= 0 || Selected.Height <= 0 ) {
+		tree.Build( snapshot.Cells.data( ), snapshot.Width, snapshot.Height );
+	} else {
+		Pattern block;
+		CopyBlock( snapshot.Cells.data( ), snapshot.Width, snapshot.Height, rules.EdgeBehavior == Wrap,
+			Selected.X, Selected.Y, Selected.Width, Selected.Height, block );
+		tree.Build( block.Cells.data( ), block.Width, block.Height );
 	}
-	if ( Width != GetScreenWidth( ) || Height != GetScreenHeight( ) ) {
-		Width = GetScreenWidth( );
-		Height = GetScreenHeight( );
-		grid.Resize( Width / Scale, Height / Scale );
+	return WriteMacrocell( path, tree, rules, snapshot.Generation, error );
+}
+
+bool Simulation::StartExport( ExportSettings settings, std::string& error ) {
+	const GridSnapshot& snapshot = snapshots.Read( );
+	settings.Colors.Size = 2;
+	settings.Colors.Colors[0] = PackColor( DeadColor.r, DeadColor.g, DeadColor.b, 255 );
+	settings.Colors.Colors[1] = PackColor( AliveColor.r, AliveColor.g, AliveColor.b, 255 );
+	return exporter.Start( settings, snapshot.Width, snapshot.Height, error );
+}
+
+bool Simulation::StopExport( std::string& error ) {
+	return exporter.Stop( error );
+}
+
+void Simulation::Update( bool suppressKeyboardUpdate = false, bool suppressMouseUpdate = false ) {
+	snapshots.Acquire( );
+	const GridSnapshot& snapshot = snapshots.Read( );
+	double now = GetTime( );
+	if ( now - lastTickRateUpdate >= 1.0 ) {
+		// A loaded world can move the generation backwards
+		const uint64_t ticks = snapshot.Generation >= lastRateGeneration ? snapshot.Generation - lastRateGeneration : 0;
+		ActualTickRate = (int)( ticks / ( now - lastTickRateUpdate ) );
+		lastRateGeneration = snapshot.Generation;
+		lastTickRateUpdate = now;
 	}
+	// The world keeps its size; a resized window just shows more or less of it
+	Width = GetScreenWidth( );
+	Height = GetScreenHeight( );
 	if ( IsKeyPressed( KEY_SPACE ) ) Paused ^= true;
-	if ( Paused && IsKeyPressed( KEY_F ) ) Tick( );
+	if ( Paused && IsKeyPressed( KEY_F ) ) Step( );
 	if ( !suppressKeyboardUpdate ) UpdateKeyboard( );
 	if ( !suppressMouseUpdate ) UpdateMouse( );
+	ClampCamera( );
+	SyncSettings( );
 	// if ( !ImGui::GetIO( ).WantCaptureKeyboard )
 	// if ( ImGui::GetIO( ).WantCaptureMouse )
 }
@@ -190,48 +908,201 @@ void Simulation::DrawBrush( int x, int y, int size ) {
 }
 
 void Simulation::Draw( bool showCursor = false ) {
+	PROFILE_ZONE( "Simulation::Draw" );
 	ClearBackground( DeadColor );
-	for ( int y = 0; y < grid.GetHeight( ); y++ ) {
-		for ( int x = 0; x < grid.GetWidth( ); x++ ) {
-			if ( grid.Get( MOD_POSITIVE( x + PanX, grid.GetWidth( ) ), MOD_POSITIVE( y + PanY, grid.GetHeight( ) ) ) ) {
-				DrawRectangle( x * Scale, y * Scale, Scale, Scale, AliveColor );
-			}
-		}
+	const GridSnapshot& snapshot = snapshots.Read( );
+	const float zoom = Camera.zoom;
+	// Only the visible rows are brought up to date and only the visible cells drawn
+	Rectangle cells = VisibleCells( );
+	const int prescale = PrescaleTexture ? std::max( (int)zoom, 1 ) : 1;
+	renderer.Update( snapshot, AliveColor, DeadColor, OldColor, prescale, ZoomLevel( ), cells );
+	Vector2 topLeft = GetWorldToScreen2D( { cells.x, cells.y }, Camera );
+	if ( cells.width > 0 && cells.height > 0 )
+		renderer.Draw( { topLeft.x, topLeft.y, cells.width * zoom, cells.height * zoom } );
+	if ( ViewAhead > 0 )
+		DrawAhead( snapshot, cells );
+	else
+		ahead.Width = 0;
+	if ( ShowHeatmap && !snapshot.Heat.empty( ) && cells.width > 0 && cells.height > 0 ) {
+		heatmap.Update( snapshot, HeatColor, ZoomLevel( ), cells, rules.EdgeBehavior == Wrap );
+		heatmap.Draw( { topLeft.x, topLeft.y, cells.width * zoom, cells.height * zoom } );
 	}
-	if ( EnableGrid ) {
-		for ( int y = 0; y < Height; y += Scale )
-			DrawLine( 0, y, Width, y, DARKGRAY );
-		for ( int x = 0; x < Width; x += Scale )
-			DrawLine( x, 0, x, Height, DARKGRAY );
+	if ( rules.EdgeBehavior != Wrap ) {
+		Vector2 origin = GetWorldToScreen2D( { 0, 0 }, Camera );
+		DrawRectangleLines( (int)origin.x - 1, (int)origin.y - 1, (int)( snapshot.Width * zoom ) + 2, (int)( snapshot.Height * zoom ) + 2, GRAY );
+	}
+	if ( EnableGrid && zoom >= 2 ) {
+		const float right = topLeft.x + cells.width * zoom;
+		const float bottom = topLeft.y + cells.height * zoom;
+		for ( float y = std::ceil( cells.y ); y <= cells.y + cells.height; y++ ) {
+			float sy = topLeft.y + ( y - cells.y ) * zoom;
+			DrawLine( (int)topLeft.x, (int)sy, (int)right, (int)sy, DARKGRAY );
+		}
+		for ( float x = std::ceil( cells.x ); x <= cells.x + cells.width; x++ ) {
+			float sx = topLeft.x + ( x - cells.x ) * zoom;
+			DrawLine( (int)sx, (int)topLeft.y, (int)sx, (int)bottom, DARKGRAY );
+		}
 	}
 	if ( Paused )
 		DrawRectangle( 0, 0, Width, Height, { 127, 127, 127, 127 } );
+	if ( Selected.Width > 0 && Selected.Height > 0 ) {
+		Vector2 corner = GetWorldToScreen2D( { (float)Selected.X, (float)Selected.Y }, Camera );
+		DrawRectangleLines( (int)corner.x, (int)corner.y, std::max( (int)( Selected.Width * zoom ), 1 ), std::max( (int)( Selected.Height * zoom ), 1 ), YELLOW );
+	}
 	int mX = GetMouseX( );
 	int mY = GetMouseY( );
 	bool outOfBounds = mX < 0 || mX >= Width || mY < 0 || mY >= Height;
-	if ( showCursor || outOfBounds ) {
+	if ( showCursor || outOfBounds || Tool != ToolBrush ) {
 		ShowCursor( );
 	} else {
 		HideCursor( );
 		float offset = BrushSize % 2 ? 0 : 0.5f;
 		float radius = BrushSize / 2.0f;
-		int x = (int)( ( (float)mX - offset ) / Scale - radius ) * Scale;
-		int y = (int)( ( (float)mY - offset ) / Scale - radius ) * Scale;
-		int size = (int)( 1 + radius * 2 ) * Scale;
+		Vector2 world = GetScreenToWorld2D( { mX - offset, mY - offset }, Camera );
+		Vector2 corner = GetWorldToScreen2D( { std::floor( world.x - radius ), std::floor( world.y - radius ) }, Camera );
+		int x = (int)corner.x;
+		int y = (int)corner.y;
+		int size = std::max( (int)( ( 1 + (int)( radius * 2 ) ) * zoom ), 1 );
 		DrawBrush( x, y, size );
-		if ( grid.EdgeBehavior == WrapSetting::Wrap ) {
-			DrawBrush( x - Width, y - Height, size );
-			DrawBrush( x, y - Height, size );
-			DrawBrush( x + Width, y - Height, size );
-			DrawBrush( x - Width, y, size );
-			DrawBrush( x + Width, y, size );
-			DrawBrush( x - Width, y + Height, size );
-			DrawBrush( x, y + Height, size );
-			DrawBrush( x + Width, y + Height, size );
+		if ( rules.EdgeBehavior == WrapSetting::Wrap ) {
+			// The brush also lands on the neighbouring copies of the world
+			int worldWidth = (int)( snapshot.Width * zoom );
+			int worldHeight = (int)( snapshot.Height * zoom );
+			DrawBrush( x - worldWidth, y - worldHeight, size );
+			DrawBrush( x, y - worldHeight, size );
+			DrawBrush( x + worldWidth, y - worldHeight, size );
+			DrawBrush( x - worldWidth, y, size );
+			DrawBrush( x + worldWidth, y, size );
+			DrawBrush( x - worldWidth, y + worldHeight, size );
+			DrawBrush( x, y + worldHeight, size );
+			DrawBrush( x + worldWidth, y + worldHeight, size );
 		}
 	}
 }
 
+void Simulation::DrawAhead( const GridSnapshot& snapshot, Rectangle cells ) {
+	if ( snapshot.Width <= 0 || snapshot.Height <= 0 || cells.width <= 0 || cells.height <= 0 )
+		return;
+	PROFILE_ZONE( "Simulation::DrawAhead" );
+	// Whole cells in view, on the density level's block boundaries so zoomed
+	// out the blocks line up with the world's
+	const int align = 1 << ZoomLevel( );
+	LightConeQuery query;
+	query.X = (int)std::floor( cells.x / align ) * align;
+	query.Y = (int)std::floor( cells.y / align ) * align;
+	query.Width = (int)std::ceil( ( cells.x + cells.width ) / align ) * align - query.X;
+	query.Height = (int)std::ceil( ( cells.y + cells.height ) / align ) * align - query.Y;
+	if ( rules.EdgeBehavior == Wrap ) {
+		// A view as wide as the world shows all of it, tiled
+		if ( query.Width >= snapshot.Width ) {
+			query.X = 0;
+			query.Width = snapshot.Width;
+		}
+		if ( query.Height >= snapshot.Height ) {
+			query.Y = 0;
+			query.Height = snapshot.Height;
+		}
+	} else {
+		query.Width = std::min( query.X + query.Width, snapshot.Width ) - query.X;
+		query.Height = std::min( query.Y + query.Height, snapshot.Height ) - query.Y;
+	}
+	query.Generations = ViewAhead;
+	query.ConeRules = rules;
+	query.Generation = snapshot.Generation;
+
+	// A new depth or rule abandons the query in progress; panning and new
+	// generations wait for it, so results keep coming while either goes on
+	const bool retarget = query.Generations != aheadQuery.Generations || query.ConeRules != aheadQuery.ConeRules;
+	if ( retarget || ( ( query != aheadQuery || snapshot.Version != aheadVersion ) && !lightCone.Busy( ) ) ) {
+		lightCone.Request( query, snapshot.Cells.data( ), snapshot.Width, snapshot.Height );
+		aheadQuery = query;
+		aheadVersion = snapshot.Version;
+	}
+
+	LightConeQuery done;
+	Pattern block;
+	if ( lightCone.Collect( done, block ) ) {
+		ahead.Cells = std::move( block.Cells );
+		ahead.Width = block.Width;
+		ahead.Height = block.Height;
+		ahead.Generation = done.Generation + done.Generations;
+		ahead.Stamp++;
+		ahead.RowStamps.assign( ahead.Height, ahead.Stamp );
+		ahead.Version++;
+		aheadShown = done;
+	}
+	if ( ahead.Width <= 0 || ahead.Height <= 0 )
+		return;
+
+	// Draw the part of the view the block covers; a block spanning the wrapped
+	// world covers the view however far it tiles
+	const LightConeQuery& shown = aheadShown;
+	const bool wrap = shown.ConeRules.EdgeBehavior == Wrap;
+	float x0 = cells.x;
+	float y0 = cells.y;
+	float x1 = cells.x + cells.width;
+	float y1 = cells.y + cells.height;
+	if ( !wrap || shown.Width < snapshot.Width ) {
+		x0 = std::max( x0, (float)shown.X );
+		x1 = std::min( x1, (float)( shown.X + shown.Width ) );
+	}
+	if ( !wrap || shown.Height < snapshot.Height ) {
+		y0 = std::max( y0, (float)shown.Y );
+		y1 = std::min( y1, (float)( shown.Y + shown.Height ) );
+	}
+	if ( x1 <= x0 || y1 <= y0 )
+		return;
+	const float zoom = Camera.zoom;
+	const int prescale = PrescaleTexture ? std::max( (int)zoom, 1 ) : 1;
+	aheadRenderer.Update( ahead, AliveColor, DeadColor, OldColor, prescale, ZoomLevel( ), { x0 - shown.X, y0 - shown.Y, x1 - x0, y1 - y0 } );
+	Vector2 topLeft = GetWorldToScreen2D( { x0, y0 }, Camera );
+	aheadRenderer.Draw( { topLeft.x, topLeft.y, ( x1 - x0 ) * zoom, ( y1 - y0 ) * zoom } );
+}
+
+Rules& Simulation::GetRules( ) {
+	return rules;
+}
+
+const GridSnapshot& Simulation::GetSnapshot( ) {
+	return snapshots.Read( );
+}
+
 Grid& Simulation::GetGrid( ) {
 	return grid;
+}
+
+History& Simulation::GetHistory( ) {
+	return history;
+}
+
+UndoStack& Simulation::GetUndo( ) {
+	return undo;
+}
+
+PerfCounters& Simulation::GetPerfCounters( ) {
+	return counters;
+}
+
+WarmUp& Simulation::GetWarmUp( ) {
+	return warmUp;
+}
+
+Speculation& Simulation::GetSpeculation( ) {
+	return speculation;
+}
+
+FrameExporter& Simulation::GetExporter( ) {
+	return exporter;
+}
+
+uint64_t Simulation::AheadGeneration( ) {
+	return ahead.Width > 0 ? ahead.Generation : 0;
+}
+
+bool Simulation::ComputingAhead( ) {
+	return lightCone.Busy( );
+}
+
+GridRenderer& Simulation::GetRenderer( ) {
+	return renderer;
 }
\ No newline at end of file
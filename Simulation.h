@@ -4,20 +4,126 @@
 
 #include <raylib.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EditQueue.h"
+#include "Engine.h"
+#include "FrameExport.h"
 #include "Grid.h"
+#include "GridRenderer.h"
+#include "Heatmap.h"
+#include "History.h"
+#include "LightCone.h"
+#include "Macrocell.h"
+#include "PerfCounters.h"
+#include "Region.h"
+#include "Speculation.h"
+#include "TripleBuffer.h"
+#include "UndoStack.h"
+#include "WarmUp.h"
+
+// A finished generation, published by the simulation thread for drawing
+struct GridSnapshot {
+	std::vector<Cell> Cells;
+	int Width = 0;
+	int Height = 0;
+	uint64_t Generation = 0;
+	uint32_t Seed = 0;
+	uint64_t Version = 0;				// Bumped on every publish, including edits between ticks
+	uint64_t Stamp = 0;					// Grid change stamp this copy is current up to
+	std::vector<uint64_t> RowStamps;	// Stamp at which each row last changed
+	std::vector<uint8_t> Ages;			// While ages are tracked, each cell's age, at least 1 if alive; empty otherwise
+	std::vector<uint8_t> Heat;			// While the heatmap is on, each cell's recent activity; empty otherwise
+	uint64_t Population = 0;			// From the engine, while engine stats are asked for
+	uint64_t Hash = 0;
+	PerfSample LastTickCounters{};
+	PerfSample TotalCounters{};
+};
+
+// Settings the simulation thread reads, handed over from the render thread every frame
+struct SimSettings {
+	int TicksPerSecond = 15;
+	bool Paused = false;
+	bool UseMultithreading = true;
+	bool UsePerfCounters = false;
+	bool UnlimitedTicks = false;
+	float UnlimitedShare = 0.5f;
+	double FrameTime = 1.0 / 60;		// Render thread's last frame time, the scheduler's budget
+	bool RecordHistory = true;
+	int HistoryKeyframeInterval = 64;
+	int HistoryMemoryMB = 256;
+	int UndoMemoryMB = 256;
+	int LookAhead = 8;
+	bool TrackAges = false;
+	bool TrackHeat = false;
+	int HeatDecay = 4;
+	std::string Engine = DefaultEngineName;
+	bool EngineStats = false;
+};
+
+// What the left and right mouse buttons do
+enum EditTool {
+	ToolBrush,		// Draw live (left) or dead (right) cells
+	ToolBucket,		// Flood fill the clicked region live (left) or dead (right)
+	ToolSelect		// Drag out a rectangular selection
+};
+
+// A rectangle of cells; may extend past the grid edges when wrapping
+struct Selection {
+	int X = 0;
+	int Y = 0;
+	int Width = 0;
+	int Height = 0;
+};
 
 class Simulation {
 public:
+	// Largest world the GUI will create
+	static const int64_t MaxWorldCells = (int64_t)1 << 27;
+
+	// Camera zoom limits in pixels per cell; below 1 a pixel shows a block of cells
+	static const int MaxZoomLevel = 12;
+	static constexpr float MinZoom = 1.0f / ( 1 << MaxZoomLevel );
+	static constexpr float MaxZoom = 64.0f;
 
 #pragma region Simulation methods
-	// Initialize simulation
+	// Initialize simulation and start the simulation thread
 	Simulation( int width, int height );
 
+	// Stop the simulation thread
+	~Simulation( );
+
 	// Reset all settings to default values
 	void ResetToDefaults( );
 
-	// Perform one tick of the simulation
-	void Tick( );
+	// Queue changes to the grid, applied on the simulation thread between generations.
+	// Safe to call from any thread.
+	void Post( const EditOp& edit );
+	void Post( std::vector<EditOp> edits );
+
+	// Queue a single tick, used while paused
+	void Step( );
+
+	// Queue a resize of the grid
+	void ResizeGrid( int width, int height );
+
+	// Zoom the camera by factor, keeping the world point under screen position fixed
+	void ZoomAt( Vector2 screen, float factor );
+
+	// Zoom and center the camera so the whole world fits in the window
+	void FitCamera( );
+
+	// Density pyramid level drawn at the current zoom: each pixel shows at most
+	// a 2^level square of cells
+	int ZoomLevel( );
+
+	// Queue a reset of the accumulated hardware counters
+	void ResetCounters( );
 
 	// Update keyboard input for simulation
 	void UpdateKeyboard( );
@@ -25,6 +131,48 @@ public:
 	// Update mouse input for simulation
 	void UpdateMouse( );
 
+	// Selection and clipboard. Copies read the newest snapshot; everything else
+	// is queued as edits. Pasting selects the pasted block.
+	void CopySelection( );
+	void CutSelection( );
+	void DeleteSelection( );
+	void Paste( int x, int y );
+	void RotateSelection( );
+	void FlipSelection( bool horizontal );
+
+	// Undo and redo whole-grid edits. MarkUndo queues a checkpoint of the grid
+	// as it will be just before the edits posted after it.
+	void MarkUndo( );
+	void Undo( );
+	void Redo( );
+
+	// RLE pattern files. Loading takes the file's rule, optionally resizes the
+	// world to the pattern and pastes it with its top-left at (x, y). Saving
+	// writes the selection, or the whole world if nothing is selected.
+	bool LoadPattern( const std::string& path, int x, int y, bool resizeWorld, std::string& error );
+	bool SavePattern( const std::string& path, std::string& error );
+
+	// Binary world snapshots with the rules, generation and seed. Saving writes
+	// the newest snapshot; loading replaces the world and its rules.
+	bool SaveWorld( const std::string& path, bool bitPacked, std::string& error );
+	bool LoadWorld( const std::string& path, std::string& error );
+
+	// Macrocell (.mc) files. A loaded pattern stays in Macrocell, and the
+	// world is filled from the window of it at MacrocellX, MacrocellY, which
+	// starts out centered on the pattern. Saving works like SavePattern.
+	bool LoadMacrocell( const std::string& path, std::string& error );
+	void MaterializeMacrocell( );
+	bool SaveMacrocell( const std::string& path, std::string& error );
+
+	// Frame export. Every generation that is a multiple of settings.Every,
+	// from the next one on, is drawn in the current colors and written out;
+	// ticking waits for the encoders when they fall behind.
+	bool StartExport( ExportSettings settings, std::string& error );
+	bool StopExport( std::string& error );
+
+	// Write the newest snapshot's heatmap as a PNG
+	bool SaveHeatmap( const std::string& path, std::string& error );
+
 	// Update simulation state
 	void Update( bool suppressKeyboardUpdate, bool suppressMouseUpdate );
 
@@ -33,53 +181,170 @@ public:
 	// Draw the game grid and cells
 	void Draw( bool showCursor );
 
+	// Rules as edited on the render thread; sent to the grid every frame they change
+	Rules& GetRules( );
+
+	// Newest generation picked up by Update
+	const GridSnapshot& GetSnapshot( );
+
+	// Owned by the simulation thread. Only its thread-safe members (Timeline) may be
+	// used from elsewhere; everything else goes through Post.
 	Grid& GetGrid( );
+
+	PerfCounters& GetPerfCounters( );
+
+	// Owned by the simulation thread; only its range and memory use may be read elsewhere
+	History& GetHistory( );
+
+	// Owned by the simulation thread; only its counts and memory use may be read elsewhere
+	UndoStack& GetUndo( );
+
+	// Warm-up run for randomized fields with preemptive iterations. Its
+	// progress may be read and it may be cancelled from any thread.
+	WarmUp& GetWarmUp( );
+
+	// Generations computed ahead while paused; only Ready may be read elsewhere
+	Speculation& GetSpeculation( );
+
+	// Frames are submitted on the simulation thread; its counters may be read anywhere
+	FrameExporter& GetExporter( );
+
+	GridRenderer& GetRenderer( );
+
+	// Generation drawn over the view while ViewAhead is set, 0 until the first
+	// one is ready, and whether a newer one is being worked out
+	uint64_t AheadGeneration( );
+	bool ComputingAhead( );
 #pragma endregion
 
 #pragma region Simulation variables
 	int Width = 1600;					// Window width
 	int Height = 900;					// Window height
+	Camera2D Camera{};					// Target is the world point at the top-left of the window, zoom is pixels per cell
 	int BrushSize = 0;					// Size of the brush for drawing cells
-	bool BrushRound = false;			// 
+	bool BrushRound = false;			// Toggled by clicking the middle mouse button; dragging it pans
+	EditTool Tool = ToolBrush;
+	Selection Selected{};				// Empty when Width or Height is 0
+	Pattern Clipboard;
+	Quadtree Macrocell;					// Last loaded macrocell pattern; empty when its Root is 0
+	int64_t MacrocellX = 0;				// Top-left of the window shown in the world, in pattern cells
+	int64_t MacrocellY = 0;
 	bool Paused = false;				// Whether the simulation is paused
 
 	int ActualTickRate{};
 	Color AliveColor{};
 	Color DeadColor{};
+	bool ColorByAge{};					// Shade live cells from AliveColor to OldColor as they age
+	Color OldColor{};
+	bool ShowHeatmap{};					// Track where cells change and draw it over the grid
+	int HeatDecay{};					// Heat lost per generation, as a shift: 1/2^HeatDecay
+	Color HeatColor{};
 
-	int Scale{};
 	int TicksPerSecond{};
+	bool UnlimitedTicks{};				// Tick as fast as possible instead of at TicksPerSecond
+	float UnlimitedShare{};				// Share of each frame spent ticking in unlimited mode
 	float PercentFilled{};
-	int PanX{};
-	int PanY{};
 
 	bool EnableGrid{};
+	bool PrescaleTexture{};				// Expand cells at the whole-pixel zoom on the CPU instead of stretching on the GPU
 	bool RandomField{};
 	bool RandomEdgeBehavior{};
 	bool RandomColors{};
 	bool RandomNeighbors{};
 	bool RandomRules{};
 	bool DisableStrobing{};
-	int PreemptiveIterations{};
+	int PreemptiveIterations{};			// Generations a randomized field runs in the background before it is shown
 
 	bool UseMultithreading{};
+	std::string EngineName;				// Registered engine computing generations; switched between them
+	bool EngineStats{};					// Publish the engine's population and hash with every snapshot
+
+	bool UsePerfCounters{};				// Read hardware counters around every tick
+
+	bool RecordHistory{};				// Keep past generations for rewinding
+	int HistoryKeyframeInterval{};		// Generations between full copies in the history
+	int HistoryMemoryMB{};				// History budget; the oldest generations go first
+	int UndoMemoryMB{};					// Undo budget, counting bands shared between steps once and leaving out the grid's own
+	int LookAhead{};					// Generations computed ahead while paused, so steps are instant
+	int ViewAhead{};					// Draw the view this many generations ahead of the world; 0 draws the world
 #pragma endregion
 
 private:
-	void PlotLine( int x0, int y0, int x1, int y1, bool value, int size );
-	void Plot( int x, int y, bool value, int size );
-	void PlotSquare( int x, int y, bool value, int size );
-	void PlotCircle( int x, int y, bool value, int size );
-	Grid grid;
-	double lastTick{};
-	double tickTime{};
-	int ticks{};
+	// Simulation thread body
+	void Run( );
+	// Cell under the mouse
+	int MouseCellX( );
+	int MouseCellY( );
+	// Perform one tick of the simulation, on the simulation thread
+	void Tick( );
+	// Apply queued edits in order, coalescing runs of span fills
+	void ApplyEdits( std::vector<EditOp>& batch );
+	void Apply( const EditOp& edit );
+	// Wake the simulation thread after a push to an empty queue
+	void Wake( );
+	// Copy the grid into a snapshot and hand it to the render thread
+	void Publish( );
+	// Send changed rules and settings to the simulation thread
+	void SyncSettings( );
+	// Add changed rules to a batch, so edits queued behind them already see them
+	void QueueRules( std::vector<EditOp>& batch );
+	// Keep the camera on the world: wrapped in Wrap mode, otherwise within half a window of it
+	void ClampCamera( );
+	// Part of the world the window shows, in cells
+	Rectangle VisibleCells( );
+	// Keep a light cone query for the view ViewAhead generations on running,
+	// and draw its newest result over the view
+	void DrawAhead( const GridSnapshot& snapshot, Rectangle cells );
+
+	// Simulation thread state
+	Grid grid;							// Where the first engine starts and engines hand the world over
+	std::unique_ptr<Engine> engine;		// Holds the world; every edit and read goes through it
+	std::string engineName;
+	bool trackingAges = false;			// Ages and heat as last asked of the engine
+	bool trackingHeat = false;
+	Pattern publishRows;				// Rows read for Publish
+	PerfCounters counters;
+	History history;
+	UndoStack undo;
+	FrameExporter exporter;
+	SimSettings simSettings;
+	PerfSample lastTickCounters{};
+	PerfSample totalCounters{};
+	uint64_t publishedVersion{};
+	double tickAccumulator{};
+	double tickCost = 0.001;			// Smoothed seconds per tick
+	std::vector<EditOp> coalesced;
+
+	// Shared between the threads
+	TripleBuffer<GridSnapshot> snapshots;
+	EditQueue edits;
+	std::mutex settingsMutex;			// Guards pendingSettings and running, and pairs with wake
+	std::condition_variable wake;
+	SimSettings pendingSettings;
+	bool running = true;
+	std::thread simThread;
+	WarmUp warmUp;						// Started and collected by the simulation thread; wakes it when done
+	Speculation speculation;			// Likewise, waking it when a stopped job ends
+
+	// Render thread state
+	GridRenderer renderer;
+	Rules rules{};
+	Rules postedRules{};
+	std::string postedEngine = DefaultEngineName;	// Engine last handed over, to spot the simulation thread refusing it
+	uint64_t lastRateGeneration{};
 	double lastTickRateUpdate{};
-	double totalTime{};
-	double lastTime;
-	float rawPanX{};
-	float rawPanY{};
 	int lastButton{};
 	int lastX{};
 	int lastY{};
+	int selectStartX{};
+	int selectStartY{};
+	Vector2 middleStart{};
+	bool middleDragged{};
+	LightCone lightCone;
+	LightConeQuery aheadQuery{};		// Last query requested
+	uint64_t aheadVersion{};			// Snapshot version it started from
+	LightConeQuery aheadShown{};		// Query the ahead snapshot holds the result of
+	GridSnapshot ahead;					// Only its cells, size and stamps are used
+	GridRenderer aheadRenderer;
+	HeatmapLayer heatmap;
 };
\ No newline at end of file
@@ -0,0 +1,260 @@
+// SnapshotFile.cpp
+
+#include "SnapshotFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "Profiler.h"
+#include "Region.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char Magic[8] = { 'L', 'I', 'F', 'E', '2', '3', 'S', 'N' };
+static const uint32_t FormatVersion = 1;
+static const uint32_t FlagBitPacked = 1;
+// The payload starts this far in, a page boundary on every platform we run on
+static const uint64_t PayloadOffset = 4096;
+// Cells written per fwrite, and packed per round of threads
+static const size_t WriteChunkCells = (size_t)64 << 20;
+// Least cells worth handing to another thread
+static const size_t ThreadedCells = (size_t)8 << 20;
+
+// On-disk header, little-endian, padded out to PayloadOffset with zeros
+struct FileHeader {
+	char Magic[8];
+	uint32_t Version;
+	uint32_t Flags;
+	int32_t Width;
+	int32_t Height;
+	uint64_t Generation;
+	uint32_t Seed;
+	int32_t EdgeBehavior;
+	uint8_t Neighborhood[8];
+	uint8_t BirthRule[9];
+	uint8_t SurviveRule[9];
+	uint8_t Reserved[6];
+	uint64_t PayloadOffset;
+	uint64_t PayloadBytes;
+};
+static_assert( sizeof( FileHeader ) == 88, "Snapshot header layout must not depend on the compiler" );
+
+// Read-only view of a whole file, mapped where the platform allows
+class MappedFile {
+public:
+	MappedFile( ) = default;
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+	~MappedFile( );
+
+	bool Open( const std::string& path );
+
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
+
+#ifdef _WIN32
+bool MappedFile::Open( const std::string& path ) {
+	file = CreateFileA( path.c_str( ), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if ( file == INVALID_HANDLE_VALUE )
+		return false;
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx( file, &size ) || size.QuadPart == 0 )
+		return false;
+	mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if ( !mapping )
+		return false;
+	Data = (const uint8_t*)MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	Size = Data ? (size_t)size.QuadPart : 0;
+	return Data != nullptr;
+}
+
+MappedFile::~MappedFile( ) {
+	if ( Data )
+		UnmapViewOfFile( Data );
+	if ( mapping )
+		CloseHandle( mapping );
+	if ( file != INVALID_HANDLE_VALUE )
+		CloseHandle( file );
+}
+#else
+bool MappedFile::Open( const std::string& path ) {
+	file = open( path.c_str( ), O_RDONLY );
+	if ( file < 0 )
+		return false;
+	struct stat status;
+	if ( fstat( file, &status ) != 0 || status.st_size == 0 )
+		return false;
+	void* data = mmap( nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+	if ( data == MAP_FAILED )
+		return false;
+	// The payload is read front to back once; ask for aggressive read-ahead
+	madvise( data, (size_t)status.st_size, MADV_SEQUENTIAL );
+	Data = (const uint8_t*)data;
+	Size = (size_t)status.st_size;
+	return true;
+}
+
+MappedFile::~MappedFile( ) {
+	if ( Data )
+		munmap( (void*)Data, Size );
+	if ( file >= 0 )
+		close( file );
+}
+#endif
+
+// Run work over cells [0, count) in ranges split on whole bytes of packed
+// cells, on as many threads as the count is worth
+static void ParallelCells( size_t count, const std::function<void( size_t, size_t )>& work ) {
+	const size_t groups = ( count + 7 ) / 8;
+	const int numThreads = (int)std::max<size_t>( 1, std::min<size_t>( std::thread::hardware_concurrency( ), count / ThreadedCells ) );
+	std::vector<std::thread> threads;
+	for ( int i = 0; i < numThreads; i++ ) {
+		size_t begin = std::min( groups * i / numThreads * 8, count );
+		size_t end = std::min( groups * ( i + 1 ) / numThreads * 8, count );
+		if ( i == numThreads - 1 )
+			work( begin, end );
+		else
+			threads.emplace_back( work, begin, end );
+	}
+	for ( auto& thread : threads ) thread.join( );
+}
+
+// Cell i goes to bit i % 8 of byte i / 8. begin is a multiple of 8.
+static void PackCells( const Cell* cells, size_t begin, size_t end, uint8_t* out ) {
+	for ( size_t i = begin; i < end; i += 8 )
+		out[i / 8] = PackByte( cells + i, (int)std::min<size_t>( 8, end - i ) );
+}
+
+static void UnpackCells( const uint8_t* packed, size_t begin, size_t end, Cell* cells ) {
+	for ( size_t i = begin; i < end; i += 8 )
+		UnpackByte( packed[i / 8], cells + i, (int)std::min<size_t>( 8, end - i ) );
+}
+
+bool WriteSnapshotFile( const std::string& path, const SnapshotInfo& info, const Cell* cells, bool bitPacked, std::string& error ) {
+	PROFILE_ZONE( "WriteSnapshotFile" );
+	const size_t count = (size_t)info.Width * info.Height;
+	FileHeader header{};
+	memcpy( header.Magic, Magic, sizeof( Magic ) );
+	header.Version = FormatVersion;
+	header.Flags = bitPacked ? FlagBitPacked : 0;
+	header.Width = info.Width;
+	header.Height = info.Height;
+	header.Generation = info.Generation;
+	header.Seed = info.Seed;
+	header.EdgeBehavior = info.WorldRules.EdgeBehavior;
+	for ( int i = 0; i < 8; i++ )
+		header.Neighborhood[i] = info.WorldRules.Neighborhood[i];
+	for ( int i = 0; i < 9; i++ ) {
+		header.BirthRule[i] = info.WorldRules.BirthRule[i];
+		header.SurviveRule[i] = info.WorldRules.SurviveRule[i];
+	}
+	header.PayloadOffset = PayloadOffset;
+	header.PayloadBytes = bitPacked ? ( count + 7 ) / 8 : count;
+
+	FILE* file = fopen( path.c_str( ), "wb" );
+	if ( !file ) {
+		error = "Could not write " + path;
+		return false;
+	}
+	std::vector<uint8_t> page( PayloadOffset, 0 );
+	memcpy( page.data( ), &header, sizeof( header ) );
+	bool written = fwrite( page.data( ), 1, page.size( ), file ) == page.size( );
+
+	// Byte cells go straight from the snapshot; packed ones are packed a chunk
+	// at a time so the extra memory stays small
+	std::vector<uint8_t> packed( bitPacked ? WriteChunkCells / 8 : 0 );
+	for ( size_t start = 0; written && start < count; start += WriteChunkCells ) {
+		const size_t chunk = std::min( WriteChunkCells, count - start );
+		if ( !bitPacked ) {
+			written = fwrite( cells + start, 1, chunk, file ) == chunk;
+			continue;
+		}
+		ParallelCells( chunk, [&]( size_t begin, size_t end ) {
+			PackCells( cells + start, begin, end, packed.data( ) );
+		} );
+		const size_t bytes = ( chunk + 7 ) / 8;
+		written = fwrite( packed.data( ), 1, bytes, file ) == bytes;
+	}
+	if ( fclose( file ) != 0 || !written ) {
+		error = "Could not write " + path;
+		return false;
+	}
+	return true;
+}
+
+bool ReadSnapshotFile( const std::string& path, SnapshotInfo& info, std::vector<Cell>& cells, std::string& error, int64_t maxCells ) {
+	PROFILE_ZONE( "ReadSnapshotFile" );
+	MappedFile file;
+	if ( !file.Open( path ) ) {
+		error = "Could not open " + path;
+		return false;
+	}
+	FileHeader header;
+	if ( file.Size < sizeof( header ) || memcmp( file.Data, Magic, sizeof( Magic ) ) != 0 ) {
+		error = path + " is not a world snapshot";
+		return false;
+	}
+	memcpy( &header, file.Data, sizeof( header ) );
+	if ( header.Version != FormatVersion || ( header.Flags & ~FlagBitPacked ) != 0 ) {
+		error = path + " was written by a newer version";
+		return false;
+	}
+	const bool bitPacked = ( header.Flags & FlagBitPacked ) != 0;
+	const size_t count = (size_t)std::max( header.Width, 0 ) * std::max( header.Height, 0 );
+	const uint64_t payloadBytes = bitPacked ? ( count + 7 ) / 8 : count;
+	if ( count == 0 || header.EdgeBehavior < AlwaysOff || header.EdgeBehavior > Wrap
+		|| header.PayloadBytes != payloadBytes || header.PayloadOffset > file.Size
+		|| file.Size - header.PayloadOffset < payloadBytes ) {
+		error = path + " is damaged or truncated";
+		return false;
+	}
+	if ( (int64_t)count > maxCells ) {
+		error = path + " is larger than the largest world";
+		return false;
+	}
+
+	info.Width = header.Width;
+	info.Height = header.Height;
+	info.Generation = header.Generation;
+	info.Seed = header.Seed;
+	info.WorldRules.EdgeBehavior = (WrapSetting)header.EdgeBehavior;
+	for ( int i = 0; i < 8; i++ )
+		info.WorldRules.Neighborhood[i] = header.Neighborhood[i] != 0;
+	for ( int i = 0; i < 9; i++ ) {
+		info.WorldRules.BirthRule[i] = header.BirthRule[i] != 0;
+		info.WorldRules.SurviveRule[i] = header.SurviveRule[i] != 0;
+	}
+
+	// Each thread faults in and copies its own stretch of the mapping
+	const uint8_t* payload = file.Data + header.PayloadOffset;
+	cells.resize( count );
+	ParallelCells( count, [&]( size_t begin, size_t end ) {
+		if ( bitPacked )
+			UnpackCells( payload, begin, end, cells.data( ) );
+		else
+			for ( size_t i = begin; i < end; i++ )
+				cells[i] = payload[i] != 0;
+	} );
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+// SnapshotFile.h
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Grid.h"
+
+// Everything in a world snapshot apart from the cells
+struct SnapshotInfo {
+	int Width = 0;
+	int Height = 0;
+	Rules WorldRules{};
+	uint64_t Generation = 0;
+	uint32_t Seed = 0;					// Seed of the world's last randomize
+};
+
+// Largest world a snapshot may hold, 32K x 32K cells. This is well past what
+// the GUI can draw; such worlds are for headless runs like --export.
+const int64_t MaxSnapshotCells = (int64_t)1 << 30;
+
+// Binary world snapshots. A fixed little-endian header is followed by the
+// cells, a byte each or bit-packed eight to a byte, starting on a page
+// boundary so the payload can be mapped and read straight from the page cache.
+// Both directions move the cells in large sequential blocks split across
+// threads, so huge worlds save and load at disk speed.
+
+// Write cells, info.Width x info.Height, to path. Returns false with a reason
+// in error if the file can't be written.
+bool WriteSnapshotFile( const std::string& path, const SnapshotInfo& info, const Cell* cells, bool bitPacked, std::string& error );
+
+// Map path and copy or unpack its cells into cells. Returns false with a
+// reason in error if the file can't be read, isn't a snapshot this version
+// understands, or holds more than maxCells cells, which is checked before
+// anything is allocated.
+bool ReadSnapshotFile( const std::string& path, SnapshotInfo& info, std::vector<Cell>& cells, std::string& error,
+	int64_t maxCells = MaxSnapshotCells );
\ No newline at end of file
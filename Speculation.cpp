@@ -0,0 +1,147 @@
+// Speculation.cpp
+
+#include "Speculation.h"
+
+#include "Profiler.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#elif defined( __APPLE__ )
+#include <pthread.h>
+#endif
+
+// Run the calling thread only when nothing else wants the core. On Linux the
+// tick threads it starts inherit this; on Windows they run at normal priority.
+static void LowerThreadPriority( ) {
+#ifdef _WIN32
+	SetThreadPriority( GetCurrentThread( ), THREAD_PRIORITY_IDLE );
+#elif defined( __linux__ )
+	sched_param param{ };
+	pthread_setschedparam( pthread_self( ), SCHED_IDLE, &param );
+#elif defined( __APPLE__ )
+	pthread_set_qos_class_self_np( QOS_CLASS_BACKGROUND, 0 );
+#endif
+}
+
+Speculation::~Speculation( ) {
+	Cancel( );
+	Join( );
+}
+
+void Speculation::Start( Engine& engine, const std::string& engineName, int depth, bool multithreaded, std::function<void( )> onFinished ) {
+	if ( running ) {
+		// A job computing from a state the engine has left is told to stop; this
+		// is called again once it has
+		std::lock_guard<std::mutex> lock( mutex );
+		if ( !stopping && !Follows( engine ) ) {
+			stopping = true;
+			room.notify_all( );
+		}
+		return;
+	}
+	Join( );
+
+	fork.reset( );
+	forkGrid = std::make_unique<Grid>( 0, 0 );
+	fork = CreateEngine( engineName );
+	if ( !fork )
+		fork = CreateEngine( DefaultEngineName );
+	fork->Attach( *forkGrid );
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		if ( !Follows( engine ) ) {
+			ahead.clear( );
+			base = engine.Checkpoint( );
+			baseRules = engine.GetRules( );
+			Publish( );
+		}
+		if ( (int)ahead.size( ) >= depth )
+			return;
+		fork->SetRules( baseRules );
+		fork->Restore( ahead.empty( ) ? base : ahead.back( ) );
+		stopping = false;
+	}
+	running = true;
+	thread = std::thread( [this, depth, multithreaded, onFinished]( ) {
+		Profiler::SetThreadName( "Speculation" );
+		LowerThreadPriority( );
+		std::unique_lock<std::mutex> lock( mutex );
+		for ( ;; ) {
+			room.wait( lock, [this, depth] { return stopping || (int)ahead.size( ) < depth; } );
+			if ( stopping )
+				break;
+			lock.unlock( );
+			fork->Step( 1, multithreaded );
+			GridCheckpoint next = fork->Checkpoint( );
+			lock.lock( );
+			if ( stopping )
+				break;
+			ahead.push_back( std::move( next ) );
+			Publish( );
+		}
+		lock.unlock( );
+		finished = true;
+		running = false;
+		if ( onFinished )
+			onFinished( );
+	} );
+}
+
+void Speculation::Stop( Engine& engine ) {
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		stopping = true;
+		room.notify_all( );
+		if ( !Follows( engine ) ) {
+			ahead.clear( );
+			Publish( );
+		}
+	}
+	if ( finished )
+		Join( );
+}
+
+bool Speculation::Take( Engine& engine ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	if ( ahead.empty( ) || !Follows( engine ) )
+		return false;
+	base = std::move( ahead.front( ) );
+	ahead.pop_front( );
+	engine.Restore( base );
+	Publish( );
+	room.notify_all( );
+	return true;
+}
+
+bool Speculation::Follows( Engine& engine ) {
+	return SameCheckpoint( engine.Checkpoint( ), base ) && engine.GetRules( ) == baseRules;
+}
+
+void Speculation::Cancel( ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	stopping = true;
+	room.notify_all( );
+}
+
+void Speculation::Join( ) {
+	if ( thread.joinable( ) )
+		thread.join( );
+	finished = false;
+}
+
+void Speculation::Publish( ) {
+	ready = (int)ahead.size( );
+}
+
+bool Speculation::Finished( ) const {
+	return finished;
+}
+
+int Speculation::Ready( ) const {
+	return ready;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+// Speculation.h
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Engine.h"
+#include "Grid.h"
+
+// Generations computed ahead of the live world on a low-priority thread, so
+// stepping through them is instant. The computed generations are checkpoints
+// of a private engine of the live one's kind, restored from its checkpoint and
+// queued up to a depth; taking one restores it into the engine. A queued generation is only taken while the
+// engine is exactly the state it follows, bands and rules alike, so any edit
+// invalidates the rest without having to be reported.
+// Start, Stop and Take belong to the thread that owns the engine; Ready may be
+// read from any thread.
+class Speculation {
+public:
+	Speculation( ) = default;
+	Speculation( const Speculation& ) = delete;
+	Speculation& operator=( const Speculation& ) = delete;
+	~Speculation( );
+
+	// Keep up to depth generations computed ahead of engine by an engine
+	// created as engineName, starting over from it if it has moved away from
+	// what is queued. finished is called on the job's thread when a job that
+	// was told to stop ends.
+	void Start( Engine& engine, const std::string& engineName, int depth, bool multithreaded, std::function<void( )> finished );
+
+	// Stop computing. Queued generations are kept while they still follow engine.
+	void Stop( Engine& engine );
+
+	// If the generation after engine's is queued, move engine to it and return true
+	bool Take( Engine& engine );
+
+	// A stopped job has ended and can be joined
+	bool Finished( ) const;
+	int Ready( ) const;
+
+private:
+	// Whether engine is the state the front of the queue follows. Called with the mutex held.
+	bool Follows( Engine& engine );
+	void Cancel( );
+	void Join( );
+	void Publish( );
+
+	std::mutex mutex;					// Guards ahead, base, baseRules and stopping
+	std::condition_variable room;		// Signalled when a generation is taken or the job is stopped
+	std::deque<GridCheckpoint> ahead;
+	GridCheckpoint base;				// State the first queued generation follows
+	Rules baseRules{};
+	bool stopping = false;
+	std::unique_ptr<Grid> forkGrid;		// Where the job's engine is attached
+	std::unique_ptr<Engine> fork;		// Steps the queued generations, on the job's thread only
+	std::thread thread;
+
+	std::atomic<bool> running{ false };
+	std::atomic<bool> finished{ false };
+	std::atomic<int> ready{ 0 };
+};
\ No newline at end of file
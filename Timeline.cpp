@@ -0,0 +1,33 @@
+// Timeline.cpp
+
+#include "Timeline.h"
+
+#include "Profiler.h"
+
+TickRecord& TickTimeline::Begin( int lanes ) {
+	pending.start = Profiler::Now( );
+	pending.end = pending.start;
+	pending.lanes = lanes;
+	pending.segments.clear( );
+	return pending;
+}
+
+void TickTimeline::Commit( ) {
+	pending.end = Profiler::Now( );
+	std::lock_guard<std::mutex> lock( mutex );
+	// Swap rather than copy so the segment storage gets reused
+	std::swap( ring[committed % Capacity], pending );
+	committed++;
+}
+
+void TickTimeline::Latest( int count, std::vector<TickRecord>& out ) {
+	std::lock_guard<std::mutex> lock( mutex );
+	uint64_t available = committed < (uint64_t)Capacity ? committed : Capacity;
+	if ( count < 0 )
+		count = 0;
+	if ( (uint64_t)count > available )
+		count = (int)available;
+	out.resize( count );
+	for ( int i = 0; i < count; i++ )
+		out[i] = ring[( committed - count + i ) % Capacity];
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+// Timeline.h
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+enum LaneState {
+	LaneBusy,		// Computing its share of the generation
+	LaneIdle,		// Finished, waiting at the barrier for the other lanes
+	LaneStealing	// Computing rows taken from another lane's share
+};
+
+struct LaneSegment {
+	int lane;
+	LaneState state;
+	uint64_t start;
+	uint64_t end;
+};
+
+// Per-lane activity for one tick. Lane 0 is the thread that called Tick,
+// lanes 1..n are the workers.
+struct TickRecord {
+	uint64_t start = 0;
+	uint64_t end = 0;
+	int lanes = 0;
+	std::vector<LaneSegment> segments;
+};
+
+// Keeps the most recent ticks' lane activity for the GUI timeline.
+class TickTimeline {
+public:
+	static const int Capacity = 240;
+
+	TickTimeline( ) = default;
+
+	// Copies start with an empty history
+	TickTimeline( const TickTimeline& ) { }
+	TickTimeline& operator=( const TickTimeline& ) { return *this; }
+
+	// Start recording a tick with the given number of lanes
+	TickRecord& Begin( int lanes );
+
+	// Publish the tick started by Begin
+	void Commit( );
+
+	// Copy the newest count ticks, oldest first
+	void Latest( int count, std::vector<TickRecord>& out );
+
+private:
+	TickRecord pending;
+	std::vector<TickRecord> ring = std::vector<TickRecord>( Capacity );
+	uint64_t committed = 0;
+	std::mutex mutex;
+};
\ No newline at end of file
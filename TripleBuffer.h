@@ -0,0 +1,44 @@
+// TripleBuffer.h
+
+#pragma once
+
+#include <atomic>
+
+// Lock-free hand-off of whole values from one writer thread to one reader thread.
+// The writer fills Write( ) and publishes it; the reader picks up the newest
+// published value with Acquire( ) and keeps reading it until the next Acquire.
+// Neither side ever waits for, or sees a half-written value from, the other.
+template <typename T>
+class TripleBuffer {
+public:
+	// Buffer owned by the writer until Publish
+	T& Write( ) {
+		return buffers[writeIndex];
+	}
+
+	// Hand the write buffer to the reader and take back a free one
+	void Publish( ) {
+		writeIndex = middle.exchange( writeIndex | FreshBit, std::memory_order_acq_rel ) & IndexMask;
+	}
+
+	// Switch to the newest published buffer. Returns false if nothing new was published.
+	bool Acquire( ) {
+		if ( !( middle.load( std::memory_order_relaxed ) & FreshBit ) )
+			return false;
+		readIndex = middle.exchange( readIndex, std::memory_order_acq_rel ) & IndexMask;
+		return true;
+	}
+
+	// Buffer owned by the reader until the next Acquire
+	const T& Read( ) const {
+		return buffers[readIndex];
+	}
+
+private:
+	static const int FreshBit = 4;
+	static const int IndexMask = 3;
+	T buffers[3];
+	int writeIndex = 0;
+	int readIndex = 1;
+	std::atomic<int> middle{ 2 };
+};
\ No newline at end of file
@@ -0,0 +1,118 @@
+// UndoStack.cpp
+
+#include "UndoStack.h"
+
+void UndoStack::SetBudget( size_t memoryBudget ) {
+	this->memoryBudget = memoryBudget;
+	Evict( );
+}
+
+void UndoStack::Push( GridCheckpoint state ) {
+	SetLive( state );
+	for ( const GridCheckpoint& entry : redo )
+		RemoveBands( entry );
+	redo.clear( );
+	if ( undo.empty( ) || !SameCheckpoint( undo.back( ), state ) ) {
+		AddBands( state );
+		undo.push_back( std::move( state ) );
+	}
+	Evict( );
+}
+
+bool UndoStack::Undo( GridCheckpoint current, GridCheckpoint& state ) {
+	if ( undo.empty( ) )
+		return false;
+	state = std::move( undo.back( ) );
+	undo.pop_back( );
+	SetLive( state );
+	RemoveBands( state );
+	AddBands( current );
+	redo.push_back( std::move( current ) );
+	Evict( );
+	return true;
+}
+
+bool UndoStack::Redo( GridCheckpoint current, GridCheckpoint& state ) {
+	if ( redo.empty( ) )
+		return false;
+	state = std::move( redo.back( ) );
+	redo.pop_back( );
+	SetLive( state );
+	RemoveBands( state );
+	AddBands( current );
+	undo.push_back( std::move( current ) );
+	Evict( );
+	return true;
+}
+
+void UndoStack::Clear( ) {
+	undo.clear( );
+	redo.clear( );
+	references.clear( );
+	live.clear( );
+	storedBytes = 0;
+	liveBytes = 0;
+	Publish( );
+}
+
+void UndoStack::AddBands( const GridCheckpoint& state ) {
+	for ( const CellBand& band : state.Bands ) {
+		if ( references[band.get( )]++ > 0 )
+			continue;
+		storedBytes += band->size( );
+		if ( live.count( band.get( ) ) )
+			liveBytes += band->size( );
+	}
+}
+
+void UndoStack::RemoveBands( const GridCheckpoint& state ) {
+	for ( const CellBand& band : state.Bands ) {
+		auto found = references.find( band.get( ) );
+		if ( --found->second > 0 )
+			continue;
+		references.erase( found );
+		storedBytes -= band->size( );
+		if ( live.count( band.get( ) ) )
+			liveBytes -= band->size( );
+	}
+}
+
+void UndoStack::SetLive( const GridCheckpoint& state ) {
+	live.clear( );
+	liveBytes = 0;
+	for ( const CellBand& band : state.Bands ) {
+		if ( live.insert( band.get( ) ).second && references.count( band.get( ) ) )
+			liveBytes += band->size( );
+	}
+}
+
+void UndoStack::Evict( ) {
+	while ( undo.size( ) > MaxSteps ) {
+		RemoveBands( undo.front( ) );
+		undo.pop_front( );
+	}
+	// Keep at least one step back, however large
+	while ( storedBytes - liveBytes > memoryBudget && undo.size( ) > 1 ) {
+		RemoveBands( undo.front( ) );
+		undo.pop_front( );
+	}
+	Publish( );
+}
+
+void UndoStack::Publish( ) {
+	undoCount = undo.size( );
+	redoCount = redo.size( );
+	memoryUsed = storedBytes - liveBytes;
+}
+
+size_t UndoStack::UndoCount( ) const {
+	return undoCount;
+}
+
+size_t UndoStack::RedoCount( ) const {
+	return redoCount;
+}
+
+size_t UndoStack::MemoryUsed( ) const {
+	return memoryUsed;
+}
\ No newline at end of file
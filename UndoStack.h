@@ -0,0 +1,69 @@
+// UndoStack.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Grid.h"
+
+// Undo and redo of whole grid states. Entries are grid checkpoints, so they
+// share unchanged bands with each other and with the live grid; memory use
+// counts each stored band once, and not at all while the grid held it at the
+// last push, undo or redo. The oldest undo entries go first to stay within the
+// budget and the step limit.
+// Pushing, undoing and redoing belong to the simulation thread; the entry
+// counts and memory use may be read from any thread.
+class UndoStack {
+public:
+	// Most undo steps kept, however little memory they share
+	static const size_t MaxSteps = 256;
+
+	UndoStack( ) = default;
+	UndoStack( const UndoStack& ) = delete;
+	UndoStack& operator=( const UndoStack& ) = delete;
+
+	void SetBudget( size_t memoryBudget );
+
+	// Remember a state to come back to and forget everything that was undone.
+	// A state the same as the newest entry is not stored twice.
+	void Push( GridCheckpoint state );
+
+	// Swap current for the newest undo (or redo) entry, keeping current on the
+	// other stack. False if there is nothing to go back (or forward) to.
+	bool Undo( GridCheckpoint current, GridCheckpoint& state );
+	bool Redo( GridCheckpoint current, GridCheckpoint& state );
+
+	void Clear( );
+
+	size_t UndoCount( ) const;
+	size_t RedoCount( ) const;
+	size_t MemoryUsed( ) const;
+
+private:
+	// Count an entry's bands in or out as it is stored or dropped
+	void AddBands( const GridCheckpoint& state );
+	void RemoveBands( const GridCheckpoint& state );
+	// The grid now holds state's bands
+	void SetLive( const GridCheckpoint& state );
+	void Evict( );
+	void Publish( );
+
+	std::deque<GridCheckpoint> undo;
+	std::deque<GridCheckpoint> redo;
+	size_t memoryBudget = (size_t)256 << 20;
+	// Entries holding each stored band, kept up to date as entries come and go
+	std::unordered_map<const std::vector<Cell>*, size_t> references;
+	// Bands of the grid as of the last push, undo or redo. Only compared with
+	// stored bands, which can't share an address with one freed since.
+	std::unordered_set<const std::vector<Cell>*> live;
+	size_t storedBytes = 0;				// Every stored band once
+	size_t liveBytes = 0;				// Stored bands the grid also holds
+
+	std::atomic<size_t> undoCount{ 0 };
+	std::atomic<size_t> redoCount{ 0 };
+	std::atomic<size_t> memoryUsed{ 0 };
+};
\ No newline at end of file
@@ -0,0 +1,72 @@
+// WarmUp.cpp
+
+#include "WarmUp.h"
+
+#include "Profiler.h"
+
+WarmUp::~WarmUp( ) {
+	Cancel( );
+	Join( );
+}
+
+void WarmUp::Start( std::unique_ptr<Grid> newGrid, std::unique_ptr<Engine> newEngine, int iterations, bool multithreaded, std::function<void( )> onFinished ) {
+	Cancel( );
+	Join( );
+	engine = std::move( newEngine );
+	grid = std::move( newGrid );
+	cancelled = false;
+	finished = false;
+	done = 0;
+	total = iterations;
+	running = true;
+	thread = std::thread( [this, iterations, multithreaded, onFinished]( ) {
+		Profiler::SetThreadName( "Warm-up" );
+		for ( int i = 0; i < iterations && !cancelled; i++ ) {
+			engine->Step( 1, multithreaded );
+			done = i + 1;
+		}
+		finished = true;
+		if ( onFinished )
+			onFinished( );
+	} );
+}
+
+void WarmUp::Cancel( ) {
+	cancelled = true;
+	running = false;
+}
+
+bool WarmUp::Collect( Engine& target ) {
+	if ( !finished )
+		return false;
+	Join( );
+	const bool complete = !cancelled && done == total;
+	if ( complete )
+		target.Restore( engine->Checkpoint( ) );
+	engine.reset( );
+	grid.reset( );
+	running = false;
+	return complete;
+}
+
+void WarmUp::Join( ) {
+	if ( thread.joinable( ) )
+		thread.join( );
+	finished = false;
+}
+
+bool WarmUp::Running( ) const {
+	return running;
+}
+
+bool WarmUp::Finished( ) const {
+	return finished;
+}
+
+int WarmUp::Done( ) const {
+	return done;
+}
+
+int WarmUp::Total( ) const {
+	return total;
+}
\ No newline at end of file
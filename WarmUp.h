@@ -0,0 +1,52 @@
+// WarmUp.h
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "Engine.h"
+#include "Grid.h"
+
+// Runs generations of a private engine on a thread of its own, so a long
+// warm-up neither blocks the simulation nor shows its intermediate states.
+// Start and Collect belong to the thread that owns the live engine; Cancel and
+// the progress counters may be used from any thread.
+class WarmUp {
+public:
+	WarmUp( ) = default;
+	WarmUp( const WarmUp& ) = delete;
+	WarmUp& operator=( const WarmUp& ) = delete;
+	~WarmUp( );
+
+	// Step engine, attached to grid, iterations times, cancelling any job
+	// already running. finished is called on the job's thread once it ends,
+	// cancelled or not.
+	void Start( std::unique_ptr<Grid> grid, std::unique_ptr<Engine> engine, int iterations, bool multithreaded, std::function<void( )> finished );
+
+	// Ask the job to stop after the generation it is on
+	void Cancel( );
+
+	// Once a job has run to the end, restore its engine's world into target
+	// and return true. A cancelled job is cleaned up and returns false.
+	bool Collect( Engine& target );
+
+	bool Running( ) const;			// Started and not yet collected or cancelled
+	bool Finished( ) const;			// Ended and waiting to be collected
+	int Done( ) const;
+	int Total( ) const;
+
+private:
+	void Join( );
+
+	std::unique_ptr<Grid> grid;
+	std::unique_ptr<Engine> engine;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	std::atomic<bool> finished{ false };
+	std::atomic<bool> cancelled{ false };
+	std::atomic<int> done{ 0 };
+	std::atomic<int> total{ 0 };
+};
\ No newline at end of file